@@ -27,6 +27,21 @@
 #include "system.h"
 #include "filehdr.h"
 
+//----------------------------------------------------------------------
+// AllocateRun
+// 	Allocate "n" sectors into "sectors", next to each other on the
+//	disk if there is room, and one by one wherever they fit if not.
+//----------------------------------------------------------------------
+
+static void
+AllocateRun(BitMap *freeMap, int *sectors, int n)
+{
+    int first = freeMap->FindRange(n);
+
+    for (int i = 0; i < n; i++)
+        sectors[i] = (first >= 0) ? first + i : freeMap->Find();
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Allocate
 // 	Initialize a fresh file header for a newly created file.
@@ -47,21 +62,21 @@ FileHeader::Allocate(BitMap *freeMap, int fileSize)
     if (freeMap->NumClear() < numSectors )//+ (numSectors - NumFirstIndex) / IndexPerSector)
         return FALSE; // not enough space
 
-    for (int i = 0; i < NumFirstIndex && numSector; i++){
-        dataSectors[i] = freeMap->Find();
-        numSector--;
+    if (numSector > 0){
+        int n = min(numSector, NumFirstIndex);
+        AllocateRun(freeMap, dataSectors, n);
+        numSector -= n;
     }
 
-    //使用二级索引
+    //使用二级索引 索引块紧挨着它索引的数据块
     for (int i = 0;numSector; i++){
-        int secondIndex[IndexPerSector];
-        int sector = freeMap->Find();
+        int run[IndexPerSector + 1];
+        int n = min(numSector, (int) IndexPerSector);
+        AllocateRun(freeMap, run, n + 1);
+        int sector = run[0];
+        int *secondIndex = run + 1;
         dataSectors[i + NumFirstIndex] = sector;
-
-        for (int j = 0; j < IndexPerSector && numSector; j++){
-            secondIndex[j] = freeMap->Find();
-            numSector--;
-        }
+        numSector -= n;
 
         synchDisk->WriteSector(sector, (char *)secondIndex);
     }
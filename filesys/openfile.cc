@@ -128,14 +128,18 @@ OpenFile::Write(char *into, int numBytes)
 //	boundary; however the disk only knows how to read/write a whole disk
 //	sector at a time.  Thus:
 //
+//	Sectors wholly inside the request go straight between the disk and
+//	the caller's buffer -- which, for Read and Write system calls, is
+//	the user's page frame -- without another copy.  Only a partial
+//	first or last sector goes through a sector buffer:
+//
 //	For ReadAt:
-//	   We read in all of the full or partial sectors that are part of the
-//	   request, but we only copy the part we are interested in.
+//	   We read in the partial sector, but we only copy the part we
+//	   are interested in.
 //	For WriteAt:
-//	   We must first read in any sectors that will be partially written,
-//	   so that we don't overwrite the unmodified portion.  We then copy
-//	   in the data that will be modified, and write back all the full
-//	   or partial sectors that are part of the request.
+//	   We must first read in the sector, so that we don't overwrite
+//	   the unmodified portion.  We then copy in the data that will
+//	   be modified, and write the sector back.
 //
 //	"into" -- the buffer to contain the data to be read from disk 
 //	"from" -- the buffer containing the data to be written to disk 
@@ -151,8 +155,8 @@ OpenFile::ReadAt(char *into, int numBytes, int position)
     //entry->rwLock->ReaderIn();
 
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    char *buf;
+    int i, firstSector, lastSector, start, end;
+    char buf[SectorSize];
 
     if ((numBytes <= 0) || (position >= fileLength)){
         //entry->rwLock->ReaderOut();
@@ -165,17 +169,19 @@ OpenFile::ReadAt(char *into, int numBytes, int position)
 
     firstSector = divRoundDown(position, SectorSize);
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
-
-    // read in all the full and partial sectors that we need
-    buf = new char[numSectors * SectorSize];
-    for (i = firstSector; i <= lastSector; i++)	
-        synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
 
-    // copy the part we want
-    bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
-    delete [] buf;
+    for (i = firstSector; i <= lastSector; i++) {
+	start = max(position, i * SectorSize);	// the part of sector i
+	end = min(position + numBytes, (i + 1) * SectorSize); // we want
+	if (end - start == SectorSize)
+	    synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize),
+					&into[start - position]);
+	else {
+	    synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize), buf);
+	    bcopy(&buf[start - i * SectorSize], &into[start - position],
+					end - start);
+	}
+    }
     //entry->rwLock->ReaderOut();
     
     return numBytes;
@@ -186,9 +192,8 @@ OpenFile::WriteAt(char *from, int numBytes, int position)
 {
     //entry->rwLock->WriterIn();
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    bool firstAligned, lastAligned;
-    char *buf;
+    int i, firstSector, lastSector, start, end;
+    char buf[SectorSize];
 			// check request
     if ((position + numBytes) > fileLength){
         if(!hdr->Grow(numBytes+position-fileLength))
@@ -206,28 +211,20 @@ OpenFile::WriteAt(char *from, int numBytes, int position)
 
     firstSector = divRoundDown(position, SectorSize);
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
-
-    buf = new char[numSectors * SectorSize];
 
-    firstAligned = (position == (firstSector * SectorSize));
-    lastAligned = ((position + numBytes) == ((lastSector + 1) * SectorSize));
-
-// read in first and last sector, if they are to be partially modified
-    if (!firstAligned)
-        ReadAt(buf, SectorSize, firstSector * SectorSize);	
-    if (!lastAligned && ((firstSector != lastSector) || firstAligned))
-        ReadAt(&buf[(lastSector - firstSector) * SectorSize], 
-				SectorSize, lastSector * SectorSize);	
-
-// copy in the bytes we want to change 
-    bcopy(from, &buf[position - (firstSector * SectorSize)], numBytes);
-
-// write modified sectors back
-    for (i = firstSector; i <= lastSector; i++)	
-        synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
-    delete [] buf;
+    for (i = firstSector; i <= lastSector; i++) {
+	start = max(position, i * SectorSize);	// the part of sector i
+	end = min(position + numBytes, (i + 1) * SectorSize); // we change
+	if (end - start == SectorSize)
+	    synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize),
+					&from[start - position]);
+	else {
+	    synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize), buf);
+	    bcopy(&from[start - position], &buf[start - i * SectorSize],
+					end - start);
+	    synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize), buf);
+	}
+    }
     //entry->rwLock->WriterOut();
     //printf("Finish Writing...\n");
     return numBytes;
@@ -170,3 +170,28 @@ SynchDisk::RequestDone()
 { 
     semaphore->V();
 }
+
+//----------------------------------------------------------------------
+// SynchDisk::Checkpoint, SynchDisk::Restore
+// 	Save the disk cache, and then the disk itself, to a checkpoint of
+//	the machine, or restore them from one (see checkpoint.cc).  The
+//	cache may hold dirty sectors, so the two only make sense together.
+//
+//	"fd" -- the UNIX file holding the checkpoint
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Checkpoint(int fd)
+{
+    WriteFile(fd, (char *) cache, sizeof(cache));
+    WriteFile(fd, (char *) &cacheTime, sizeof(int));
+    disk->Checkpoint(fd);
+}
+
+void
+SynchDisk::Restore(int fd)
+{
+    Read(fd, (char *) cache, sizeof(cache));
+    Read(fd, (char *) &cacheTime, sizeof(int));
+    disk->Restore(fd);
+}
@@ -58,6 +58,10 @@ class SynchDisk {
     int ExpelCache();
     int FindCache(int sector);
 
+    void Checkpoint(int fd);		// Save the cache and the disk to,
+    void Restore(int fd);		// or restore them from, a checkpoint
+					// of the machine
+
   private:
     Disk *disk;		  		// Raw disk device
     Semaphore *semaphore; 		// To synchronize requesting thread 
@@ -93,11 +93,11 @@ Console::CheckCharAvail()
 			ConsoleReadInt);
     
     // do nothing if character is already buffered, or none to be read
-    if ((incoming != EOF) || !PollFile(readFileNo))
+    if ((incoming != EOF) || !traceLog->PollFile(readFileNo))
 	return;	  
 
     // otherwise, read character and tell user about it
-    Read(readFileNo, &c, sizeof(char));
+    traceLog->Read(readFileNo, &c, sizeof(char));
     incoming = c ;
     stats->numConsoleCharsRead++;
     (*readHandler)(handlerArg);	
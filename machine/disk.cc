@@ -276,4 +276,43 @@ Disk::UpdateLast(int newSector)
 	bufferInit = stats->totalTicks + seek + rotate;
     lastSector = newSector;
     DEBUG('d', "Updating last sector = %d, %d\n", lastSector, bufferInit);
-}
\ No newline at end of file
+}
+
+//----------------------------------------------------------------------
+// Disk::Checkpoint, Disk::Restore
+//   	Save the contents of the disk, and what is in the track buffer,
+//	to a checkpoint of the machine, or restore them from one (see
+//	checkpoint.cc).  There must be no request in progress.
+//
+//	"fd" -- the UNIX file holding the checkpoint
+//----------------------------------------------------------------------
+
+void
+Disk::Checkpoint(int fd)
+{
+    char data[SectorSize];
+
+    ASSERT(!active);
+    WriteFile(fd, (char *) &lastSector, sizeof(int));
+    WriteFile(fd, (char *) &bufferInit, sizeof(int));
+    Lseek(fileno, MagicSize, 0);
+    for (int i = 0; i < NumSectors; i++) {
+	Read(fileno, data, SectorSize);
+	WriteFile(fd, data, SectorSize);
+    }
+}
+
+void
+Disk::Restore(int fd)
+{
+    char data[SectorSize];
+
+    ASSERT(!active);
+    Read(fd, (char *) &lastSector, sizeof(int));
+    Read(fd, (char *) &bufferInit, sizeof(int));
+    Lseek(fileno, MagicSize, 0);
+    for (int i = 0; i < NumSectors; i++) {
+	Read(fd, data, SectorSize);
+	WriteFile(fileno, data, SectorSize);
+    }
+}
@@ -69,6 +69,8 @@ class Disk {
 
     void HandleInterrupt();		// Interrupt handler, invoked when
 					// disk request finishes.
+    void Checkpoint(int fd);		// Save the disk to, or restore it
+    void Restore(int fd);		// from, a checkpoint of the machine
 
     int ComputeLatency(int newSector, bool writing);	
     					// Return how long a request to 
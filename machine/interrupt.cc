@@ -49,6 +49,23 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, int time,
     arg = param;
     when = time;
     type = kind;
+    order = 0;
+    next = NULL;
+}
+
+//----------------------------------------------------------------------
+// Before [helper]
+// 	Return TRUE if "a" must fire before "b": it is due earlier, or
+//	at the same time but was scheduled first.  Compared so that it
+//	keeps working after "order" wraps around.
+//----------------------------------------------------------------------
+
+static bool
+Before(PendingInterrupt *a, PendingInterrupt *b)
+{
+    if (a->when != b->when)
+	return a->when < b->when;
+    return (int) (a->order - b->order) < 0;
 }
 
 //----------------------------------------------------------------------
@@ -61,7 +78,11 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, int time,
 Interrupt::Interrupt()
 {
     level = IntOff;
-    pending = new List();
+    maxPending = 16;
+    pending = new PendingInterrupt *[maxPending];
+    numPending = 0;
+    nextOrder = 0;
+    freePending = NULL;
     inHandler = FALSE;
     yieldOnReturn = FALSE;
     status = SystemMode;
@@ -74,9 +95,15 @@ Interrupt::Interrupt()
 
 Interrupt::~Interrupt()
 {
-    while (!pending->IsEmpty())
-	delete (PendingInterrupt *)pending->Remove();
-    delete pending;
+    PendingInterrupt *p;
+
+    while (numPending > 0)
+	delete HeapRemove();
+    delete [] pending;
+    while ((p = freePending) != NULL) {
+	freePending = p->next;
+	delete p;
+    }
 }
 
 //----------------------------------------------------------------------
@@ -150,10 +177,14 @@ Interrupt::Enable()
 //	Two things can cause OneTick to be called:
 //		interrupts are re-enabled
 //		a user instruction is executed
+//
+//	"count" -- the number of user instructions being accounted for
+//		at once (the block engine charges a whole block per call);
+//		any interrupt that fell due meanwhile fires now.
 //----------------------------------------------------------------------
 
 void
-Interrupt::OneTick()
+Interrupt::OneTick(int count)
 {
  
     //printf("Ticked\n");
@@ -164,8 +195,8 @@ Interrupt::OneTick()
         stats->totalTicks += SystemTick;
 	stats->systemTicks += SystemTick;
     } else {					// USER_PROGRAM
-	stats->totalTicks += UserTick;
-	stats->userTicks += UserTick;
+	stats->totalTicks += count * UserTick;
+	stats->userTicks += count * UserTick;
     }
     DEBUG('i', "\n== Tick %d ==\n", stats->totalTicks);
 
@@ -183,9 +214,90 @@ Interrupt::OneTick()
 					// for a context switch, ok to do it now
 	yieldOnReturn = FALSE;
  	status = SystemMode;		// yield is a kernel routine
+#ifdef USER_PROGRAM
+	currentThread->preempted = (old == UserMode);
+#endif
 	currentThread->Yield();
+#ifdef USER_PROGRAM
+	currentThread->preempted = FALSE;
+#endif
 	status = old;
     }
+    if ((scheduler->numCPUs > 1) && (scheduler->SliceLeft() <= 0)) {
+	status = SystemMode;		// let the other processors catch up
+	scheduler->NextSlice(old == UserMode);
+	status = old;
+    }
+#ifdef USER_PROGRAM
+    // Between two user instructions is the one place a checkpoint can
+    // be taken; if the kernel is busy, try again on a later tick.
+    if ((old == UserMode) && (checkpointTick >= 0) 
+		&& (stats->totalTicks >= checkpointTick)
+		&& SaveCheckpoint(checkpointFile))
+	checkpointTick = -1;
+#endif
+}
+
+//----------------------------------------------------------------------
+// Interrupt::UserHorizon
+// 	Return the number of user instructions after which the earliest
+//	pending interrupt falls due -- that is, the smallest "count" for
+//	which OneTick(count) would fire it.  The CPU engines run that
+//	many instructions between calls to OneTick, instead of ticking
+//	once per instruction; since nothing can fire in between, the
+//	simulated timing is the same.
+//
+//	With nothing pending, any batch size is exact; we return a large
+//	one.  On a multiprocessor the end of the current processor's slice
+//	counts as pending too.
+//----------------------------------------------------------------------
+
+int
+Interrupt::UserHorizon()
+{
+    int when = NextDue();
+
+    if (scheduler->numCPUs > 1) {
+	int sliceEnd = stats->totalTicks + scheduler->SliceLeft();
+
+	if ((when < 0) || (when > sliceEnd))
+	    when = sliceEnd;
+    }
+    if (when < 0)
+	return MaxUserHorizon;
+    if (when <= stats->totalTicks)
+	return 1;
+    return divRoundUp(when - stats->totalTicks, UserTick);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::NextDue
+// 	Return the time at which the earliest pending interrupt is due,
+//	or -1 if nothing is pending.  The head of the heap, so O(1).
+//----------------------------------------------------------------------
+
+int
+Interrupt::NextDue()
+{
+    if (numPending == 0)
+	return -1;
+    return pending[0]->when;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::AdvanceUserTime
+// 	Charge "count" user instructions to simulated time, without
+//	checking for interrupts.  Only valid when "count" is less than
+//	UserHorizon(): the CPU uses this to bring the clock up to date
+//	for instructions run in the current batch before it traps into
+//	the kernel.
+//----------------------------------------------------------------------
+
+void
+Interrupt::AdvanceUserTime(int count)
+{
+    stats->totalTicks += count * UserTick;
+    stats->userTicks += count * UserTick;
 }
 
 //----------------------------------------------------------------------
@@ -251,6 +363,14 @@ void
 Interrupt::Halt()
 {
     printf("Machine halting!\n\n");
+#ifdef USER_PROGRAM
+    stats->numUserInstrs += machine->userInstrs;
+    machine->userInstrs = 0;
+#endif
+    if (scheduler->numCPUs > 1) {
+	stats->totalTicks = scheduler->ElapsedTicks();
+	scheduler->PrintCPUs();
+    }
     stats->Print();
     Cleanup();     // Never returns.
 }
@@ -260,7 +380,8 @@ Interrupt::Halt()
 // 	Arrange for the CPU to be interrupted when simulated time
 //	reaches "now + when".
 //
-//	Implementation: just put it on a sorted list.
+//	Implementation: put it on the "pending" heap, using a 
+//	PendingInterrupt from the pool if there is one.
 //
 //	NOTE: the Nachos kernel should not call this routine directly.
 //	Instead, it is only called by the hardware device simulators.
@@ -275,13 +396,164 @@ void
 Interrupt::Schedule(VoidFunctionPtr handler, int arg, int fromNow, IntType type)
 {
     int when = stats->totalTicks + fromNow;
-    PendingInterrupt *toOccur = new PendingInterrupt(handler, arg, when, type);
+    PendingInterrupt *toOccur = freePending;
+
+    if (toOccur == NULL)
+	toOccur = new PendingInterrupt(handler, arg, when, type);
+    else {
+	freePending = toOccur->next;
+	toOccur->handler = handler;
+	toOccur->arg = arg;
+	toOccur->when = when;
+	toOccur->type = type;
+    }
+    toOccur->order = nextOrder++;
 
     DEBUG('i', "Scheduling interrupt handler the %s at time = %d\n", 
 					intTypeNames[type], when);
     ASSERT(fromNow > 0);
 
-    pending->SortedInsert(toOccur, when);
+    HeapInsert(toOccur);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::HeapInsert
+// 	Add "toOccur" to the pending heap, growing the array if needed.
+//----------------------------------------------------------------------
+
+void
+Interrupt::HeapInsert(PendingInterrupt *toOccur)
+{
+    int i, parent;
+
+    if (numPending == maxPending) {
+	PendingInterrupt **bigger = new PendingInterrupt *[2 * maxPending];
+
+	for (i = 0; i < numPending; i++)
+	    bigger[i] = pending[i];
+	delete [] pending;
+	pending = bigger;
+	maxPending *= 2;
+    }
+    for (i = numPending++; i > 0; i = parent) {	// sift up
+	parent = (i - 1) / 2;
+	if (!Before(toOccur, pending[parent]))
+	    break;
+	pending[i] = pending[parent];
+    }
+    pending[i] = toOccur;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::HeapRemove
+// 	Take the first interrupt to occur off the pending heap and
+//	return it.  The heap must not be empty.
+//----------------------------------------------------------------------
+
+PendingInterrupt *
+Interrupt::HeapRemove()
+{
+    PendingInterrupt *first = pending[0];
+    PendingInterrupt *last = pending[--numPending];
+    int i, child;
+
+    for (i = 0; (child = 2 * i + 1) < numPending; i = child) {	// sift down
+	if (child + 1 < numPending && Before(pending[child + 1], pending[child]))
+	    child++;
+	if (!Before(pending[child], last))
+	    break;
+	pending[i] = pending[child];
+    }
+    pending[i] = last;
+    return first;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Quiescent
+// 	Return TRUE if no device has an operation in progress: the only
+//	interrupts pending are the timer, and the console and network
+//	polling for input.  Only then can the machine be checkpointed,
+//	since a checkpoint can't hold a disk request or a packet half
+//	sent.
+//----------------------------------------------------------------------
+
+bool
+Interrupt::Quiescent()
+{
+    for (int i = 0; i < numPending; i++)
+	if ((pending[i]->type != TimerInt) 
+		&& (pending[i]->type != ConsoleReadInt)
+		&& (pending[i]->type != NetworkRecvInt))
+	    return FALSE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Checkpoint
+// 	Save the pending interrupts to a checkpoint of the machine: the
+//	kind, time and order of each.  Handlers are host code, so they
+//	aren't saved (see Interrupt::Restore).
+//
+//	"fd" -- the UNIX file holding the checkpoint
+//----------------------------------------------------------------------
+
+void
+Interrupt::Checkpoint(int fd)
+{
+    WriteFile(fd, (char *) &numPending, sizeof(int));
+    WriteFile(fd, (char *) &nextOrder, sizeof(unsigned int));
+    for (int i = 0; i < numPending; i++) {
+	WriteFile(fd, (char *) &pending[i]->type, sizeof(IntType));
+	WriteFile(fd, (char *) &pending[i]->when, sizeof(int));
+	WriteFile(fd, (char *) &pending[i]->order, sizeof(unsigned int));
+    }
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Restore
+// 	Restore the pending interrupts from a checkpoint.  The devices
+//	of this run have already scheduled their own interrupts, with
+//	the right handlers; each is matched with a saved interrupt of the
+//	same kind, and takes its time and order.  So this run must have
+//	been started with the same devices as the one checkpointed.
+//
+//	Interrupts are left enabled, without advancing the simulated time,
+//	ready to go straight back to the user program.
+//
+//	"fd" -- the UNIX file holding the checkpoint
+//----------------------------------------------------------------------
+
+void
+Interrupt::Restore(int fd)
+{
+    PendingInterrupt **saved = new PendingInterrupt *[numPending];
+    int numSaved, numFound = 0;
+    IntType type;
+    int i;
+
+    Read(fd, (char *) &numSaved, sizeof(int));
+    Read(fd, (char *) &nextOrder, sizeof(unsigned int));
+    ASSERT(numSaved == numPending);
+    for (i = 0; i < numPending; i++)
+	saved[i] = NULL;
+    while (numFound < numSaved) {
+	Read(fd, (char *) &type, sizeof(IntType));
+	for (i = 0; i < numPending; i++)
+	    if ((saved[i] == NULL) && (pending[i]->type == type))
+		break;
+	ASSERT(i < numPending);		// no such device in this run
+	saved[i] = pending[i];
+	Read(fd, (char *) &saved[i]->when, sizeof(int));
+	Read(fd, (char *) &saved[i]->order, sizeof(unsigned int));
+	numFound++;
+    }
+    numPending = 0;			// rebuild the heap on the new times
+    for (i = 0; i < numSaved; i++)
+	HeapInsert(saved[i]);
+    delete [] saved;
+
+    level = IntOn;
+    yieldOnReturn = FALSE;
 }
 
 //----------------------------------------------------------------------
@@ -310,27 +582,24 @@ Interrupt::CheckIfDue(bool advanceClock)
 					// to invoke an interrupt handler
     if (DebugIsEnabled('i'))
 	DumpState();
-    PendingInterrupt *toOccur = 
-		(PendingInterrupt *)pending->SortedRemove(&when);
-
-    if (toOccur == NULL)		// no pending interrupts
+    if (numPending == 0)		// no pending interrupts
 	return FALSE;			
+    PendingInterrupt *toOccur = pending[0];	// look, but leave it there
+    when = toOccur->when;
 
     if (advanceClock && when > stats->totalTicks) {	// advance the clock
 	stats->idleTicks += (when - stats->totalTicks);
     // 时间跳跃！！！！
 	stats->totalTicks = when;
-    } else if (when > stats->totalTicks) {	// not time yet, put it back
-	pending->SortedInsert(toOccur, when);
+    } else if (when > stats->totalTicks)	// not time yet
 	return FALSE;
-    }
 
 // Check if there is nothing more to do, and if so, quit
     if ((status == IdleMode) && (toOccur->type == TimerInt) 
-				&& pending->IsEmpty()) {
-	 pending->SortedInsert(toOccur, when);
+				&& (numPending == 1))
 	 return FALSE;
-    }
+    (void) HeapRemove();
+    traceLog->Delivered(toOccur->type);
 
     DEBUG('i', "Invoking interrupt handler for the %s at time %d\n", 
 			intTypeNames[toOccur->type], toOccur->when);
@@ -345,7 +614,8 @@ Interrupt::CheckIfDue(bool advanceClock)
     (*(toOccur->handler))(toOccur->arg);	// call the interrupt handler
     status = old;				// restore the machine status
     inHandler = FALSE;
-    delete toOccur;
+    toOccur->next = freePending;		// back to the pool
+    freePending = toOccur;
     return TRUE;
 }
 
@@ -356,10 +626,8 @@ Interrupt::CheckIfDue(bool advanceClock)
 //----------------------------------------------------------------------
 
 static void
-PrintPending(int arg)
+PrintPending(PendingInterrupt *pend)
 {
-    PendingInterrupt *pend = (PendingInterrupt *)arg;
-
     printf("Interrupt handler %s, scheduled at %d\n", 
 	intTypeNames[pend->type], pend->when);
 }
@@ -377,7 +645,19 @@ Interrupt::DumpState()
 					intLevelNames[level]);
     printf("Pending interrupts:\n");
     fflush(stdout);
-    pending->Mapcar(PrintPending);
+
+    // print them in the order they will occur, from a sorted copy
+    PendingInterrupt **sorted = new PendingInterrupt *[numPending];
+    int i, j;
+
+    for (i = 0; i < numPending; i++) {
+	for (j = i; j > 0 && Before(pending[i], sorted[j - 1]); j--)
+	    sorted[j] = sorted[j - 1];
+	sorted[j] = pending[i];
+    }
+    for (i = 0; i < numPending; i++)
+	PrintPending(sorted[i]);
+    delete [] sorted;
     printf("End of pending interrupts\n");
     fflush(stdout);
 }
@@ -38,6 +38,9 @@
 #include "copyright.h"
 #include "list.h"
 
+#define MaxUserHorizon	(1 << 20)	// longest batch of user instructions
+					// between calls to OneTick
+
 // Interrupts can be disabled (IntOff) or enabled (IntOn)
 enum IntStatus { IntOff, IntOn };
 
@@ -67,6 +70,9 @@ class PendingInterrupt {
     int arg;                    // The argument to the function.
     int when;			// When the interrupt is supposed to fire
     IntType type;		// for debugging
+    unsigned int order;		// when it was scheduled, relative to the
+				// others; breaks ties between equal "when"s
+    PendingInterrupt *next;	// next unused entry, while in the pool
 };
 
 // The following class defines the data structures for the simulation
@@ -99,6 +105,11 @@ class Interrupt {
     void setStatus(MachineStatus st) { status = st; }
 
     void DumpState();			// Print interrupt state
+
+    bool Quiescent();			// No device operation in progress?
+    void Checkpoint(int fd);		// Save the pending interrupts to,
+    void Restore(int fd);		// or restore them from, a checkpoint
+					// of the machine
     
 
     // NOTE: the following are internal to the hardware simulation code.
@@ -110,12 +121,25 @@ class Interrupt {
 	int arg, int when, IntType type);// at time ``when''.  This is called
     					// by the hardware device simulators.
     
-    void OneTick();       		// Advance simulated time
+    void OneTick(int count = 1);	// Advance simulated time, by
+					// "count" instructions in user mode
+    int NextDue();			// When the earliest pending interrupt
+					// is due, or -1 if there are none
+    int UserHorizon();			// How many user instructions can
+					// run before an interrupt is due
+    void AdvanceUserTime(int count);	// Account for "count" user 
+					// instructions, during which no
+					// interrupt can have fallen due
 
   private:
     IntStatus level;		// are interrupts enabled or disabled?
-    List *pending;		// the list of interrupts scheduled
-				// to occur in the future
+    PendingInterrupt **pending;	// the interrupts scheduled to occur in
+				// the future, as a binary min-heap on
+				// (when, order): pending[0] is next
+    int numPending;		// # of interrupts in the heap
+    int maxPending;		// size of the "pending" array
+    unsigned int nextOrder;	// "order" of the next one scheduled
+    PendingInterrupt *freePending; // pool of PendingInterrupts to reuse
     bool inHandler;		// TRUE if we are running an interrupt handler
     bool yieldOnReturn; 	// TRUE if we are to context switch
 				// on return from the interrupt handler
@@ -125,6 +149,9 @@ class Interrupt {
 
     bool CheckIfDue(bool advanceClock); // Check if an interrupt is supposed
 					// to occur now
+    void HeapInsert(PendingInterrupt *toOccur);
+    PendingInterrupt *HeapRemove();	// Add or take away the first of
+					// the pending interrupts
 
     void ChangeLevel(IntStatus old, 	// SetLevel, without advancing the
 	IntStatus now);  		// simulated time
@@ -0,0 +1,416 @@
+// jit.cc
+//	A small dynamic translator from MIPS basic blocks to x86 host
+//	code, used by the "-e jit" engine for blocks that have become hot.
+//
+//	Only instructions that can never trap are compiled: register
+//	arithmetic and logic, shifts, compares, moves to and from Hi/Lo,
+//	LUI, and a branch or jump together with its delay slot.  A block's
+//	host code covers its longest such prefix and works directly on
+//	Machine::registers, which stays the only copy of the CPU state.
+//	Loads, stores, multiply/divide, trapping arithmetic and syscalls
+//	are left to the interpreter, so every exception is still raised
+//	by Machine::Execute and reaches ExceptionHandler as usual.
+//
+//	All the encodings used are 32-bit operations addressed off a base
+//	register, which mean the same thing on i386 and x86-64 hosts; only
+//	the way the argument arrives differs.  On any other host
+//	CompileBlock declines, and "-e jit" behaves like "-e block".
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "machine.h"
+#include "mipssim.h"
+#include "system.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+#define HOST_HAS_JIT
+#endif
+
+#define MaxNativeBlock	2048	// more code than any one block needs
+
+// x86 encoding constants.  EDX holds &registers[0] for the whole of a
+// generated routine; EAX and ECX are scratch.
+
+#define X86_ADD		0x01	// op r/m32, r32 (and op eax, imm32 + 4)
+#define X86_OR		0x09
+#define X86_AND		0x21
+#define X86_SUB		0x29
+#define X86_XOR		0x31
+#define X86_CMP		0x39
+
+#define X86_SHL		4	// /n field of the shift group
+#define X86_SAR		7
+
+#define X86_SETL	0x9c	// second byte of setcc
+#define X86_SETB	0x92
+
+#define X86_JE		0x74	// jcc rel8
+#define X86_JNE		0x75
+#define X86_JL		0x7c
+#define X86_JGE		0x7d
+#define X86_JLE		0x7e
+#define X86_JG		0x7f
+
+#define EAX		0	// register numbers in the ModRM byte
+#define ECX		1
+
+// The following class writes the code for one block.  Each call of
+// CompileBlock has its own, so that the processors of a multiprocessor
+// running ahead on host threads can compile at the same time (each
+// into its own Machine's jitCode).
+
+class Emitter {
+  public:
+    Emitter(unsigned char *start) { emit = start; }
+
+    unsigned char *emit;	// where the next byte of code goes
+
+    void Byte(int b);
+    void Word(int w);
+    void RegOperand(int opcode, int reg, int num);
+
+    void LoadEAX(int num) { RegOperand(0x8b, EAX, num); }
+    void LoadECX(int num) { RegOperand(0x8b, ECX, num); }
+    void StoreEAX(int num) { RegOperand(0x89, EAX, num); }
+    void StoreImm(int num, int value) { RegOperand(0xc7, EAX, num); Word(value); }
+    void MoveEAX(int value) { Byte(0xb8); Word(value); }
+
+    void Alu(int op) { Byte(op); Byte(0xc8); }		// op eax, ecx
+    void AluImm(int op, int value) { Byte(op + 4); Word(value); }
+    void ShiftImm(int n, int count) { Byte(0xc1); Byte(0xc0 | (n << 3)); Byte(count); }
+    void ShiftCL(int n) { Byte(0xd3); Byte(0xc0 | (n << 3)); }
+    void SetEAX(int cc) { Byte(0x0f); Byte(cc); Byte(0xc0); Byte(0x0f); Byte(0xb6); Byte(0xc0); }
+    void SkipMove(int jcc) { Byte(jcc); Byte(5); }	// over a MoveEAX
+
+    void EmitSimple(Instruction *instr);
+    void EmitBranch(Instruction *instr, int pc);
+};
+
+void
+Emitter::Byte(int b)
+{
+    *emit++ = (unsigned char) b;
+}
+
+void
+Emitter::Word(int w)
+{
+    memcpy(emit, &w, 4);
+    emit += 4;
+}
+
+// op reg, [edx + 4*num]  or  op [edx + 4*num], reg
+void
+Emitter::RegOperand(int opcode, int reg, int num)
+{
+    Byte(opcode);
+    Byte(0x82 | (reg << 3));
+    Word(4 * num);
+}
+
+//----------------------------------------------------------------------
+// IsSimple, IsCompilableBranch [helpers]
+// 	Classify the instructions the translator knows how to compile.
+//----------------------------------------------------------------------
+
+static bool
+IsSimple(int opCode)
+{
+    switch (opCode) {
+      case OP_ADDIU: case OP_ADDU: case OP_SUBU: case OP_AND: case OP_ANDI:
+      case OP_OR: case OP_ORI: case OP_XOR: case OP_XORI: case OP_NOR:
+      case OP_LUI: case OP_SLL: case OP_SRL: case OP_SRA: case OP_SLLV:
+      case OP_SRLV: case OP_SRAV: case OP_SLT: case OP_SLTI: case OP_SLTU:
+      case OP_SLTIU: case OP_MFHI: case OP_MFLO: case OP_MTHI: case OP_MTLO:
+	return TRUE;
+      default:
+	return FALSE;
+    }
+}
+
+static bool
+IsCompilableBranch(int opCode)
+{
+    switch (opCode) {
+      case OP_BEQ: case OP_BNE: case OP_BGEZ: case OP_BGEZAL:
+      case OP_BGTZ: case OP_BLEZ: case OP_BLTZ: case OP_BLTZAL:
+      case OP_J: case OP_JAL: case OP_JALR: case OP_JR:
+	return TRUE;
+      default:
+	return FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// Emitter::EmitSimple
+// 	Generate code for one instruction accepted by IsSimple.  Each case
+//	must compute exactly what Machine::Execute does, including its
+//	quirks (OR only looks at rs, SRL and SRLV shift arithmetically).
+//	A write to r0 is followed by clearing it again, as DelayedLoad
+//	does after every instruction.
+//----------------------------------------------------------------------
+
+void
+Emitter::EmitSimple(Instruction *instr)
+{
+    int dest = instr->rd;
+
+    switch (instr->opCode) {
+      case OP_ADDIU:
+	LoadEAX(instr->rs); AluImm(X86_ADD, instr->extra); dest = instr->rt;
+	break;
+      case OP_ADDU:
+	LoadEAX(instr->rs); LoadECX(instr->rt); Alu(X86_ADD);
+	break;
+      case OP_SUBU:
+	LoadEAX(instr->rs); LoadECX(instr->rt); Alu(X86_SUB);
+	break;
+      case OP_AND:
+	LoadEAX(instr->rs); LoadECX(instr->rt); Alu(X86_AND);
+	break;
+      case OP_XOR:
+	LoadEAX(instr->rs); LoadECX(instr->rt); Alu(X86_XOR);
+	break;
+      case OP_NOR:
+	LoadEAX(instr->rs); LoadECX(instr->rt); Alu(X86_OR);
+	Byte(0xf7); Byte(0xd0);				// not eax
+	break;
+      case OP_OR:					// (sic)
+	LoadEAX(instr->rs);
+	break;
+      case OP_ANDI:
+	LoadEAX(instr->rs); AluImm(X86_AND, instr->extra & 0xffff);
+	dest = instr->rt;
+	break;
+      case OP_ORI:
+	LoadEAX(instr->rs); AluImm(X86_OR, instr->extra & 0xffff);
+	dest = instr->rt;
+	break;
+      case OP_XORI:
+	LoadEAX(instr->rs); AluImm(X86_XOR, instr->extra & 0xffff);
+	dest = instr->rt;
+	break;
+      case OP_LUI:
+	MoveEAX((int) ((unsigned int) instr->extra << 16)); dest = instr->rt;
+	break;
+      case OP_SLL:
+	LoadEAX(instr->rt); ShiftImm(X86_SHL, instr->extra);
+	break;
+      case OP_SRL:					// (sic)
+      case OP_SRA:
+	LoadEAX(instr->rt); ShiftImm(X86_SAR, instr->extra);
+	break;
+      case OP_SLLV:
+	LoadEAX(instr->rt); LoadECX(instr->rs); ShiftCL(X86_SHL);
+	break;
+      case OP_SRLV:					// (sic)
+      case OP_SRAV:
+	LoadEAX(instr->rt); LoadECX(instr->rs); ShiftCL(X86_SAR);
+	break;
+      case OP_SLT:
+	LoadEAX(instr->rs); LoadECX(instr->rt); Alu(X86_CMP); SetEAX(X86_SETL);
+	break;
+      case OP_SLTU:
+	LoadEAX(instr->rs); LoadECX(instr->rt); Alu(X86_CMP); SetEAX(X86_SETB);
+	break;
+      case OP_SLTI:
+	LoadEAX(instr->rs); AluImm(X86_CMP, instr->extra); SetEAX(X86_SETL);
+	dest = instr->rt;
+	break;
+      case OP_SLTIU:
+	LoadEAX(instr->rs); AluImm(X86_CMP, instr->extra); SetEAX(X86_SETB);
+	dest = instr->rt;
+	break;
+      case OP_MFHI:
+	LoadEAX(HiReg);
+	break;
+      case OP_MFLO:
+	LoadEAX(LoReg);
+	break;
+      case OP_MTHI:
+	LoadEAX(instr->rs); dest = HiReg;
+	break;
+      case OP_MTLO:
+	LoadEAX(instr->rs); dest = LoReg;
+	break;
+      default:
+	ASSERT(FALSE);
+    }
+    StoreEAX(dest);
+    if (dest == 0)
+	StoreImm(0, 0);
+}
+
+//----------------------------------------------------------------------
+// Emitter::EmitBranch
+// 	Generate code for the branch or jump at virtual address "pc":
+//	write the link register if any, then leave the address execution
+//	continues at after the delay slot in registers[PCReg].  Nothing
+//	in a compiled delay slot reads PCReg, so it is safe to set early.
+//----------------------------------------------------------------------
+
+void
+Emitter::EmitBranch(Instruction *instr, int pc)
+{
+    int fallThrough = pc + 8;
+    int target = pc + 4 + IndexToAddr(instr->extra);
+
+    switch (instr->opCode) {
+      case OP_JAL:
+	StoreImm(R31, pc + 8);
+      case OP_J:
+	MoveEAX((fallThrough & 0xf0000000) | IndexToAddr(instr->extra));
+	break;
+      case OP_JALR:
+	StoreImm(instr->rd, pc + 8);
+	LoadEAX(instr->rs);
+	if (instr->rd == 0)
+	    StoreImm(0, 0);
+	break;
+      case OP_JR:
+	LoadEAX(instr->rs);
+	break;
+      case OP_BEQ:
+      case OP_BNE:
+	LoadEAX(instr->rs); LoadECX(instr->rt); Alu(X86_CMP);
+	MoveEAX(fallThrough);
+	SkipMove(instr->opCode == OP_BEQ ? X86_JNE : X86_JE);
+	MoveEAX(target);
+	break;
+      case OP_BGEZAL:
+      case OP_BLTZAL:
+	StoreImm(R31, pc + 8);
+      default:				// compare rs against zero
+	LoadEAX(instr->rs);
+	Byte(0x85); Byte(0xc0);		// test eax, eax
+	MoveEAX(fallThrough);
+	switch (instr->opCode) {
+	  case OP_BGEZ: case OP_BGEZAL: SkipMove(X86_JL); break;
+	  case OP_BLTZ: case OP_BLTZAL: SkipMove(X86_JGE); break;
+	  case OP_BGTZ: SkipMove(X86_JLE); break;
+	  case OP_BLEZ: SkipMove(X86_JG); break;
+	  default: ASSERT(FALSE);
+	}
+	MoveEAX(target);
+	break;
+    }
+    StoreEAX(PCReg);
+}
+
+//----------------------------------------------------------------------
+// Machine::CompileBlock
+// 	Generate host code for the longest compilable prefix of "block".
+//	The code runs as NativeCode(registers) and returns the number of
+//	instructions it completed, leaving the PC registers and the load
+//	delay state exactly as that many calls to Execute would.
+//
+//	It may only be entered when no delayed load is pending and we are
+//	not in a branch delay slot -- ExecuteNative checks that.
+//
+//	Returns NULL if nothing in the block can be compiled, or the host
+//	cannot run generated code.
+//----------------------------------------------------------------------
+
+NativeCode
+Machine::CompileBlock(TranslatedBlock *block)
+{
+#ifdef HOST_HAS_JIT
+    unsigned char *start;
+    bool branch = FALSE;
+    int n, i, last;
+
+    for (n = 0; n < block->numInstrs && IsSimple(block->code[n].opCode); n++)
+	;
+    if (n + 1 < block->numInstrs && IsCompilableBranch(block->code[n].opCode)
+	    && IsSimple(block->code[n + 1].opCode)) {
+	n += 2;				// the branch and its delay slot
+	branch = TRUE;
+    }
+    if (n == 0)
+	return NULL;
+
+    if (jitCode == NULL) {
+	jitCode = AllocExecutableArray(JitCodeSize);
+	if (jitCode == NULL)
+	    return NULL;
+    }
+    if (jitCodeUsed + MaxNativeBlock > JitCodeSize) {
+	DEBUG('a', "JIT code buffer full, discarding all host code\n");
+	for (i = 0; i < NumBlocks; i++) {
+	    blockCache[i].native = NULL;
+	    blockCache[i].executions = 0;
+	}
+	jitCodeUsed = 0;
+    }
+    start = (unsigned char *) jitCode + jitCodeUsed;
+    Emitter e(start);
+
+#ifdef __x86_64__
+    e.Byte(0x48); e.Byte(0x89); e.Byte(0xfa);		// mov rdx, rdi
+#else
+    e.Byte(0x8b); e.Byte(0x54); e.Byte(0x24); e.Byte(0x04); // mov edx, [esp+4]
+#endif
+    for (i = 0; i < n; i++) {
+	if (branch && i == n - 2)
+	    e.EmitBranch(&block->code[i], block->vaddr + 4 * i);
+	else
+	    e.EmitSimple(&block->code[i]);
+    }
+
+    // Leave the program counters as the last Execute would have.
+    last = block->vaddr + 4 * (n - 1);
+    e.StoreImm(PrevPCReg, last);
+    if (branch) {
+	e.LoadEAX(PCReg);
+	e.AluImm(X86_ADD, 4);
+	e.StoreEAX(NextPCReg);
+    } else {
+	e.StoreImm(PCReg, last + 4);
+	e.StoreImm(NextPCReg, last + 8);
+    }
+    e.StoreImm(LoadValueReg, 0);		// the entry check saw LoadReg == 0
+    e.MoveEAX(n);
+    e.Byte(0xc3);				// ret
+
+    ASSERT(e.emit - start <= MaxNativeBlock);
+    jitCodeUsed += e.emit - start;
+    block->nativeInstrs = n;
+    for (block->nativeCycles = 0, i = 0; i < n; i++)
+	block->nativeCycles += opCycles[(int) block->code[i].opCode];
+    DEBUG('a', "Compiled %d of %d instructions at VA 0x%x\n", n,
+	  block->numInstrs, block->vaddr);
+    return (NativeCode) start;
+#else
+    return NULL;
+#endif
+}
+
+//----------------------------------------------------------------------
+// Machine::ExecuteNative
+// 	Run the host code for "block", compiling it on its JitThreshold'th
+//	execution.  Returns how many of its instructions were completed;
+//	0 if the block has no host code, or cannot be entered right now,
+//	or its compiled prefix takes more than "budget" cycles (what is
+//	left before the next interrupt is due).
+//----------------------------------------------------------------------
+
+int
+Machine::ExecuteNative(TranslatedBlock *block, int budget)
+{
+    if (block->native == NULL) {
+	if (block->executions > JitThreshold)
+	    return 0;			// tried already; nothing to compile
+	if (block->executions++ < JitThreshold)
+	    return 0;
+	block->native = CompileBlock(block);
+	if (block->native == NULL)
+	    return 0;
+    }
+    if (block->nativeCycles > budget || registers[LoadReg] != 0
+	    || registers[NextPCReg] != registers[PCReg] + 4)
+	return 0;
+    return (*block->native)(registers);
+}
@@ -12,6 +12,12 @@
 #include "system.h"
 #include <string.h>
 
+// The size of the machine (see machine.h), set before it is built.
+int NumPhysPages = DefaultPhysPages;
+int NumSwapPages = DefaultSwapPages;
+int TLBSize = DefaultTLBSize;
+int TLBWays = DefaultTLBSize;
+
 // Textual names of the exceptions that can be generated by user program
 // execution, for debugging.
 static char* exceptionNames[] = { "no exception", "syscall", 
@@ -62,8 +68,44 @@ Machine::Machine(bool debug)
     mainMemory = new char[MemorySize];
     for (i = 0; i < MemorySize; i++)
       	mainMemory[i] = 0;
-    memoryMap = new BitMap(NumPhysPages); // 初始化位图
+    decodeCache = new Instruction[NumInstrSlots];
+    decoded = new bool[NumInstrSlots];
+    for (i = 0; i < NumInstrSlots; i++)
+	decoded[i] = FALSE;
+    frameGeneration = new unsigned int[NumPhysPages];
+    for (i = 0; i < NumPhysPages; i++)
+	frameGeneration[i] = 0;
+    blockCache = new TranslatedBlock[NumBlocks];
+    for (i = 0; i < NumBlocks; i++)
+	blockCache[i].space = NULL;
+    unchargedCycles = 0;
+    userInstrs = 0;
+    opCycles = NULL;
+    InitCostModel();
+    jitCode = NULL;			// allocated on first use
+    jitCodeUsed = 0;
+    detached = FALSE;
+    trapped = FALSE;
+    tlbHits = 0;
+    tlbStamp = 0;
+    nextCore = NULL;
+    profile = NULL;
+    frames = new Frame[NumPhysPages];	// all free, in order
+    for (i = 0; i < NumPhysPages; i++) {
+	frames[i].owner = NULL;
+	frames[i].vpn = -1;
+	frames[i].sharers = NULL;
+	frames[i].refCount = frames[i].pinCount = 0;
+	frames[i].replaceState = 0;
+	frames[i].nextFree = (i + 1 < NumPhysPages) ? i + 1 : -1;
+    }
+    freeFrames = 0;
+    replacePolicy = RoundRobin;
+    faultAround = DefaultFaultAround;
     swapMap = new BitMap(NumSwapPages);    // 交换空间管理
+    swapRefs = new int[NumSwapPages];
+    for (i = 0; i < NumSwapPages; i++)
+	swapRefs[i] = 0;
     
 // #ifdef USER_PROGRAM
 //     fileSystem->Create("SwapSpace", NumSwapPages * PageSize);
@@ -81,11 +123,70 @@ Machine::Machine(bool debug)
     tlb = NULL;
     pageTable = NULL;
 #endif
+    FlushSoftTLB();
 
     singleStep = debug;
+    engine = SwitchEngine;
     CheckEndian();
 } 
 
+//----------------------------------------------------------------------
+// Machine::Machine
+// 	Initialize another core of the simulated machine.  It has its own
+//	registers, TLB and simulator caches, but shares main memory (and
+//	its predecoded copy) with "boot", the machine the kernel runs
+//	user programs on.  The core is detached: the kernel loads it with
+//	a thread's state, lets it RunDetached, and takes the state back.
+//
+//	"boot" -- the machine whose memory this core shares
+//----------------------------------------------------------------------
+
+Machine::Machine(Machine *boot)
+{
+    int i;
+
+    for (i = 0; i < NumTotalRegs; i++)
+        registers[i] = 0;
+    mainMemory = boot->mainMemory;
+    decodeCache = boot->decodeCache;
+    decoded = boot->decoded;
+    frameGeneration = boot->frameGeneration;
+    blockCache = new TranslatedBlock[NumBlocks];
+    for (i = 0; i < NumBlocks; i++)
+	blockCache[i].space = NULL;
+    unchargedCycles = 0;
+    userInstrs = 0;
+    opCycles = boot->opCycles;
+    tlbMissCycles = boot->tlbMissCycles;
+    pageFaultCycles = boot->pageFaultCycles;
+    jitCode = NULL;
+    jitCodeUsed = 0;
+    detached = TRUE;
+    trapped = FALSE;
+    tlbHits = 0;
+    tlbStamp = 0;
+    profile = NULL;
+    frames = NULL;			// only the kernel allocates memory
+    freeFrames = -1;
+    swapMap = NULL;
+    swapRefs = NULL;
+    swapSpace = NULL;
+    if (boot->tlb != NULL) {
+	tlb = new TranslationEntry[TLBSize];
+	for (i = 0; i < TLBSize; i++)
+	    tlb[i].valid = FALSE;
+    } else
+	tlb = NULL;
+    pageTable = NULL;
+    pageTableSize = 0;
+    FlushSoftTLB();
+
+    singleStep = boot->singleStep;
+    engine = boot->engine;
+    nextCore = boot->nextCore;		// let boot find us, to flush blocks
+    boot->nextCore = this;
+}
+
 //----------------------------------------------------------------------
 // Machine::~Machine
 // 	De-allocate the data structures used to simulate user program execution.
@@ -93,10 +194,154 @@ Machine::Machine(bool debug)
 
 Machine::~Machine()
 {
-    delete [] mainMemory;
+    if (!detached) {			// cores only borrow these
+	delete [] mainMemory;
+	delete [] decodeCache;
+	delete [] decoded;
+	delete [] frameGeneration;
+	delete [] opCycles;
+	delete [] frames;
+	delete swapMap;
+	delete [] swapRefs;
+    }
+    delete [] blockCache;
     if (tlb != NULL)
         delete [] tlb;
-    delete memoryMap;
+}
+
+//----------------------------------------------------------------------
+// Machine::InvalidateFrame
+// 	Forget every predecoded instruction held for a physical page.
+//	Must be called whenever the kernel refills a frame behind the
+//	simulator's back (page allocation, swap-in, loading from the
+//	executable); stores made by user code go through WriteMem, which
+//	invalidates the single word it touches.  Either way the frame's
+//	generation moves on, which retires its translated blocks.
+//
+//	"frame" -- the physical page number whose contents are changing
+//----------------------------------------------------------------------
+
+void
+Machine::InvalidateFrame(int frame)
+{
+    int first = frame * PageSize / 4;
+
+    ASSERT((frame >= 0) && (frame < NumPhysPages));
+    for (int i = 0; i < PageSize / 4; i++)
+	decoded[first + i] = FALSE;
+    frameGeneration[frame]++;
+}
+
+//----------------------------------------------------------------------
+// Machine::FlushBlocks
+// 	Forget every translated block belonging to an address space that
+//	is going away, so that a later page table allocated at the same
+//	address can never match them.  Cores sharing our memory forget
+//	theirs too.
+//
+//	"space" -- the page table of the address space being torn down
+//----------------------------------------------------------------------
+
+void
+Machine::FlushBlocks(TranslationEntry *space)
+{
+    for (int i = 0; i < NumBlocks; i++)
+	if (blockCache[i].space == space)
+	    blockCache[i].space = NULL;
+    if (nextCore != NULL)
+	nextCore->FlushBlocks(space);
+}
+
+//----------------------------------------------------------------------
+// Machine::Checkpoint
+// 	Save the simulated hardware to a checkpoint of the machine (see
+//	checkpoint.cc): the registers, main memory, the TLB, the map of
+//	swap space and the frame table, all but who owns each frame.
+//	With the stub file system the swap space is a UNIX file, so its
+//	contents are saved too; with the real one it is saved with the
+//	rest of the disk.
+//
+//	"fd" -- the UNIX file holding the checkpoint
+//----------------------------------------------------------------------
+
+void
+Machine::Checkpoint(int fd)
+{
+    int geometry[4] = { NumPhysPages, NumSwapPages, TLBSize, TLBWays };
+
+    WriteFile(fd, (char *) geometry, sizeof(geometry));
+    WriteFile(fd, (char *) registers, sizeof(registers));
+    WriteFile(fd, mainMemory, MemorySize);
+    if (tlb != NULL)
+	WriteFile(fd, (char *) tlb, TLBSize * sizeof(TranslationEntry));
+    WriteFile(fd, (char *) &userInstrs, sizeof(int));
+    swapMap->Checkpoint(fd);
+    WriteFile(fd, (char *) swapRefs, NumSwapPages * sizeof(int));
+    WriteFile(fd, (char *) &freeFrames, sizeof(int));
+    for (int i = 0; i < NumPhysPages; i++) {	// owners are the kernel's
+	WriteFile(fd, (char *) &frames[i].refCount, sizeof(int));
+	WriteFile(fd, (char *) &frames[i].replaceState, sizeof(int));
+	WriteFile(fd, (char *) &frames[i].nextFree, sizeof(int));
+    }
+#ifdef FILESYS_STUB
+    char page[PageSize];
+
+    for (int i = 0; i < NumSwapPages; i++) {
+	bzero(page, PageSize);		// the file may be shorter
+	swapSpace->ReadAt(page, PageSize, i * PageSize);
+	WriteFile(fd, page, PageSize);
+    }
+#endif
+}
+
+//----------------------------------------------------------------------
+// Machine::Restore
+// 	Restore the simulated hardware from a checkpoint.  Everything the
+//	simulator has cached about the old contents of memory -- 
+//	predecoded instructions, translated blocks, translations -- is
+//	dropped.
+//
+//	"fd" -- the UNIX file holding the checkpoint
+//----------------------------------------------------------------------
+
+void
+Machine::Restore(int fd)
+{
+    int geometry[4];
+
+    Read(fd, (char *) geometry, sizeof(geometry));
+    if ((geometry[0] != NumPhysPages) || (geometry[1] != NumSwapPages)
+	    || (geometry[2] != TLBSize) || (geometry[3] != TLBWays)) {
+	printf("The checkpoint is of a machine with %d pages of memory, "
+	       "%d of swap space and a %d-entry, %d-way TLB\n",
+	       geometry[0], geometry[1], geometry[2], geometry[3]);
+	fflush(stdout);
+	ASSERT(FALSE);
+    }
+    Read(fd, (char *) registers, sizeof(registers));
+    Read(fd, mainMemory, MemorySize);
+    if (tlb != NULL)
+	Read(fd, (char *) tlb, TLBSize * sizeof(TranslationEntry));
+    Read(fd, (char *) &userInstrs, sizeof(int));
+    swapMap->Restore(fd);
+    Read(fd, (char *) swapRefs, NumSwapPages * sizeof(int));
+    Read(fd, (char *) &freeFrames, sizeof(int));
+    for (int i = 0; i < NumPhysPages; i++) {
+	Read(fd, (char *) &frames[i].refCount, sizeof(int));
+	Read(fd, (char *) &frames[i].replaceState, sizeof(int));
+	Read(fd, (char *) &frames[i].nextFree, sizeof(int));
+    }
+#ifdef FILESYS_STUB
+    char page[PageSize];
+
+    for (int i = 0; i < NumSwapPages; i++) {
+	Read(fd, page, PageSize);
+	swapSpace->WriteAt(page, PageSize, i * PageSize);
+    }
+#endif
+    for (int i = 0; i < NumPhysPages; i++)
+	InvalidateFrame(i);
+    FlushSoftTLB();
 }
 
 //----------------------------------------------------------------------
@@ -112,13 +357,20 @@ Machine::~Machine()
 void
 Machine::RaiseException(ExceptionType which, int badVAddr)
 {
+    if (detached) {			// the kernel will take it when it
+	trapped = TRUE;			// runs the instruction again
+	return;
+    }
     DEBUG('m', "Exception: %s\n", exceptionNames[which]);
     
 //  ASSERT(interrupt->getStatus() == UserMode);
     registers[BadVAddrReg] = badVAddr;  // pagefault的虚拟地址 39
+    interrupt->AdvanceUserTime(unchargedCycles); // the kernel must see
+    unchargedCycles = 0;		// the time of this instruction
     DelayedLoad(0, 0);			// finish anything in progress
     interrupt->setStatus(SystemMode);   // 陷入内核
     ExceptionHandler(which);		// interrupts are enabled at this point
+    FlushSoftTLB();			// the kernel may have changed mappings
     interrupt->setStatus(UserMode);     // 从内核返回
 }
 
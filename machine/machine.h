@@ -34,6 +34,7 @@
 #include "translate.h"
 #include "disk.h"
 #include "bitmap.h"
+#include "profile.h"
 
 // Definitions related to the size, and format of user memory
 
@@ -41,10 +42,31 @@
 					// the disk sector size, for
 					// simplicity
 
-#define NumPhysPages    32
-#define NumSwapPages	2
+// The size of memory, swap space and the TLB is chosen when Nachos
+// starts ("-mem", "-swap", "-tlb"; see Initialize in system.cc), and
+// must not change once the machine is built.  Until then these hold
+// the defaults.
+#define DefaultPhysPages 32
+#define DefaultSwapPages 2
+#define DefaultTLBSize	4		// if there is a TLB, make it small
+#define MaxPhysPages	((1 << 30) / PageSize)	// keeps MemorySize an int
+
+extern int NumPhysPages;		// frames of main memory
+extern int NumSwapPages;		// pages of swap space
+extern int TLBSize;			// TLB entries
+extern int TLBWays;			// entries a virtual page may use: its
+					// set (see Machine::TLBSet); TLBSize
+					// if the TLB is fully associative
 #define MemorySize 	(NumPhysPages * PageSize)
-#define TLBSize		4		// if there is a TLB, make it small
+#define NumInstrSlots	(MemorySize / 4)	// one predecode slot per word
+#define MaxBlockInstrs	(PageSize / 4)	// a translated block never
+					// crosses a page boundary
+#define NumBlocks	256		// translated block cache entries
+#define JitThreshold	16		// runs of a block before it is 
+					// compiled to host code
+#define JitCodeSize	(64 * 1024)	// bytes of generated host code
+#define SoftTLBSize	64		// host translation cache entries per
+					// access type (a power of two)
 
 enum ExceptionType { NoException,           // Everything ok!
 		     SyscallException,      // A program executed a system call.
@@ -64,6 +86,47 @@ enum ExceptionType { NoException,           // Everything ok!
 
 typedef unsigned int uint;
 
+// The interpreter loops Machine::Run can use to execute user code,
+// chosen at startup with "-e".  SwitchEngine is the reference.
+enum ExecEngine { SwitchEngine,		// OneInstruction per instruction
+		  ThreadedEngine,	// computed-goto handler per opcode
+		  BlockEngine,		// cached basic blocks
+		  JitEngine		// hot blocks compiled to host code
+};
+
+// The policies GetPage can use to choose a frame to take from its
+// owner when memory is full, chosen at startup with "-pr".  All of
+// them go round the frames from the same hand (scar), skipping pinned
+// frames, and judge a frame by its owner's use and dirty bits.
+enum ReplacePolicy { RoundRobin,	// the next frame, used or not
+		     ClockPolicy,	// the next frame not used since the
+					// hand last passed it
+		     SecondChance,	// the same, preferring frames that
+					// needn't be written back
+		     WSClockPolicy,	// the next frame whose page has left
+					// the working set, preferring clean
+		     AgingPolicy	// the frame used least lately, by
+					// counters aged at each replacement
+};
+
+#define WorkingSetTicks	2000	// a page not used for this long has left
+				// the working set, for WSClock
+
+extern char *replacePolicyNames[];
+
+// On a page fault, the kernel also brings in the pages after the one
+// faulted on that come from the same place in the same file (fault-
+// around), as long as there are free frames.  It starts with one page,
+// and doubles the window, up to "-fa" pages, each time a program
+// faults just past the pages brought in last time.
+#define DefaultFaultAround 8	// the largest window, unless "-fa"
+#define MaxFaultAround	32
+
+// Host code generated for a block by the JIT.  It runs a prefix of the
+// block directly on the register file passed in and returns how many
+// instructions it completed; the interpreter carries on from there.
+typedef int (*NativeCode)(int *registers);
+
 // User program CPU state.  The full set of MIPS registers, plus a few
 // more because we need to be able to start/stop a user program between
 // any two instructions (thus we need to keep track of things like load
@@ -105,6 +168,67 @@ class Instruction {
                      // Immediates are sign-extended.
 };
 
+// The following class defines a basic block of user code, translated
+// once into predecoded instructions and cached by the block engine.
+// A block is a straight run of instructions starting at "vaddr", 
+// ending after the first branch or jump and its delay slot (or at the
+// end of the page).  It belongs to the address space whose page table
+// was installed when it was translated, and is only valid while the
+// physical page it came from has not been invalidated since.
+
+class TranslatedBlock {
+  public:
+    TranslationEntry *space;	// page table it was translated under,
+				// NULL if the cache entry is empty
+    int vaddr;			// virtual address of the first instruction
+    int frame;			// physical page holding the code
+    unsigned int generation;	// frameGeneration[frame] when translated
+    int numInstrs;		// instructions in the block
+    Instruction code[MaxBlockInstrs];
+    int executions;		// times run since translation (JIT only)
+    NativeCode native;		// compiled prefix of the block, or NULL
+    int nativeInstrs;		// # instructions in the compiled prefix
+    int nativeCycles;		// and what they cost (see opCycles)
+};
+
+// The following class defines one entry of the simulator's own cache of
+// recent translations.  It is not part of the simulated hardware: an
+// entry only exists while the page it names has been translated, and had
+// its use (and for writes, dirty) bits set, under the current page table
+// and TLB contents, so repeating the translation would change nothing.
+
+class SoftTLBEntry {
+  public:
+    int vpn;			// virtual page number, -1 if empty
+    char *host;			// where the page's frame is in mainMemory
+    int tlbSlot;		// tlb[] entry a hit is charged to, or -1
+				// when translating with the page table
+};
+
+// The following class defines the kernel's record of one frame of main
+// memory: the page in it -- kept as its address space and virtual page
+// number, which stay put when a page table is reallocated -- and what
+// GetPage needs to choose it as a victim.  Free frames are linked
+// together instead, so that a frame is allocated in constant time.
+
+class AddrSpace;
+class List;
+
+class Frame {
+  public:
+    AddrSpace *owner;		// whose page "vpn" is in the frame; NULL
+    int vpn;			// if it is free
+    List *sharers;		// after a Fork, the other address spaces
+				// with the same page in it; NULL if none
+    int refCount;		// 1 + # sharers, or 0 if free
+    int pinCount;		// I/O in progress on it; GetPage never
+				// takes a frame that is pinned
+    int replaceState;		// what the replacement policy keeps on
+				// it: the tick WSClock last saw it used,
+				// or its aging counter
+    int nextFree;		// next on the free list, -1 at the end
+};
+
 // The following class defines the simulated host workstation hardware, as 
 // seen by user programs -- the CPU registers, main memory, etc.
 // User programs shouldn't be able to tell that they are running on our 
@@ -117,16 +241,31 @@ class Instruction {
 //
 // The procedures in this class are defined in machine.cc, mipssim.cc, and
 // translate.cc.
+//
+// Besides "machine" itself, the kernel may create further cores sharing
+// its memory (see Machine(Machine *boot)).  A core only ever runs user 
+// code detached from the kernel, on a host thread of its own: it stops
+// short of any instruction that would trap, instead of trapping.
 
 class Machine {
   public:
     Machine(bool debug);	// Initialize the simulation of the hardware
 				// for running user programs
+    Machine(Machine *boot);	// Initialize another core, sharing the
+				// memory of "boot"
     ~Machine();			// De-allocate the data structures
 
 // Routines callable by the Nachos kernel
     void Run();	 		// Run a user program
 
+    int RunDetached(int budget);	// Run up to "budget" cycles of user
+				// code without the kernel (cores only);
+				// return # run before an instruction
+				// would have trapped
+    void LoadCostModel(char *fileName);
+				// Read the cost of each instruction, and
+				// of TLB misses and page faults
+
     int ReadRegister(int num);	// read the contents of a CPU register
 
     void WriteRegister(int num, int value);
@@ -135,8 +274,42 @@ class Machine {
 
 // Routines internal to the machine simulation -- DO NOT call these 
 
-    void OneInstruction(Instruction *instr); 	
-    				// Run one instruction of a user program.
+    void RunThreaded();		// Run() using the threaded engine
+    void RunBlocks();		// Run() using the block engine
+
+    bool OneInstruction(Instruction *instr); 	
+    				// Run one instruction of a user program;
+				// return FALSE if it raised an exception
+    int Horizon();		// # cycles to run before the next call
+				// to interrupt->OneTick
+    void InitCostModel();	// One cycle per instruction, no stalls
+    bool Execute(Instruction *instr);
+				// Execute a fetched instruction; return 
+				// FALSE if it raised an exception
+    TranslatedBlock *FindBlock(int addr);
+				// Return the translated block starting at
+				// "addr", translating it if necessary; 
+				// NULL if fetching it raised an exception
+    bool ExecuteBlock(TranslatedBlock *block, int horizon);
+				// Run a block, counting cycles in
+				// unchargedCycles up to "horizon"; return
+				// FALSE if it raised an exception
+    void FlushBlocks(TranslationEntry *space);
+				// Drop every block of an address space
+    int ExecuteNative(TranslatedBlock *block, int budget);
+				// Run the compiled prefix of a hot block, if
+				// it takes no more than "budget" cycles;
+				// return # instructions it completed
+    NativeCode CompileBlock(TranslatedBlock *block);
+				// Generate host code for a block (jit.cc)
+    bool Fetch(int addr, Instruction *instr);
+				// Fetch the instruction at virtual address
+				// "addr", decoding it only if the predecode
+				// cache has no valid copy.  Return FALSE if
+				// the fetch raised an exception.
+    void InvalidateFrame(int frame);
+				// Drop predecoded instructions of a physical
+				// page whose contents are being replaced
     void DelayedLoad(int nextReg, int nextVal);  	
 				// Do a pending delayed load (modifying a reg)
     
@@ -152,6 +325,18 @@ class Machine {
 				// the translation entry appropriately,
     				// and return an exception code if the 
 				// translation couldn't be completed.
+    char *SoftTranslate(int addr, int size, bool writing);
+				// Translate through the host-side cache;
+				// NULL if Translate must be called
+    void FlushSoftTLB();	// Forget every cached translation; called
+				// whenever the page table or TLB changes
+    void TouchTLB(int slot);	// Count a hit on tlb[slot]
+    int TLBSet(unsigned int vpn) { return vpn % (TLBSize / TLBWays) * TLBWays; }
+				// First TLB slot that may hold "vpn"; it
+				// may use TLBWays slots from there
+    void ChargeStall(bool tlbMiss, bool pageFault);
+				// Charge user code for a TLB miss and/or
+				// a page fault (see the cost model)
 
     void RaiseException(ExceptionType which, int badVAddr);
 				// Trap to the Nachos kernel, because of a
@@ -159,6 +344,8 @@ class Machine {
 
     void Debugger();		// invoke the user program debugger
     void DumpState();		// print the user CPU and memory state
+    void Checkpoint(int fd);	// save the hardware state to, or restore
+    void Restore(int fd);	// it from, a checkpoint of the machine
 
     void PCAdvance();   // PC+=4 一般用于系统调用结束
 
@@ -175,6 +362,40 @@ class Machine {
 
     int registers[NumTotalRegs]; // CPU registers, for executing user programs
 
+    ExecEngine engine;		// which interpreter loop Run() uses
+    int unchargedCycles;	// cycles of the instructions completed in
+				// the current batch (see Horizon), not yet
+				// added to simulated time
+    int *opCycles;		// the cost model: cycles (of UserTick
+				// each) taken by an instruction, by opCode
+    int tlbMissCycles;		// and the stall when user code misses in
+    int pageFaultCycles;	// the TLB, or touches an invalid page
+    int userInstrs;		// instructions completed, for the kernel
+				// to add to stats->numUserInstrs
+
+    Instruction *decodeCache;	// predecoded copy of every word in 
+				// mainMemory, indexed by physAddr / 4
+    bool *decoded;		// TRUE if the matching decodeCache slot
+				// holds the current contents of memory
+    unsigned int *frameGeneration; // bumped whenever a frame's code
+				// may have changed; stale blocks fail
+				// to match it
+    TranslatedBlock *blockCache; // translated blocks, hashed by 
+				// address space and virtual address
+    char *jitCode;		// executable buffer for the JIT, or NULL
+    int jitCodeUsed;		// bytes of it handed out so far
+    SoftTLBEntry softTLB[2][SoftTLBSize]; // cached translations, for
+				// reading [0] and writing [1], by vpn
+
+    bool detached;		// TRUE for a core; exceptions are then
+    bool trapped;		// only noted here, for the kernel to take
+				// when it re-executes the instruction
+    int tlbHits;		// a core's TLB statistics and LRU stamps,
+    int tlbStamp;		// merged by the kernel afterwards
+    Machine *nextCore;		// other cores sharing this memory
+    Profile *profile;		// where to count executed instructions,
+				// or NULL; installed with the page table
+
 
 // NOTE: the hardware translation of virtual addresses in the user program
 // to physical addresses (relative to the beginning of "mainMemory")
@@ -198,10 +419,15 @@ class Machine {
 					// "read-only" to Nachos kernel code
 
     TranslationEntry *pageTable;
-    BitMap *memoryMap; // Lab4 位图
+    Frame *frames;		// the frame table, one per physical page
+    int freeFrames;		// first free frame, -1 if none
     BitMap *swapMap;	// Lab4 交换空间管理
+    int *swapRefs;		// page tables referring to each swap page;
+				// after a Fork, parent and child share it
     OpenFile *swapSpace; 
-    TranslationEntry *page2Entry[NumPhysPages];	// 记录页表项所属的进程呢...
+    ReplacePolicy replacePolicy; // how GetPage chooses a frame to evict
+    int faultAround;		// most pages brought in after one a
+				// program faults on; 0 for none
     unsigned int pageTableSize;
 
     private:
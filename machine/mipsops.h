@@ -0,0 +1,450 @@
+// mipsops.h 
+//	The body of every MIPS instruction, shared by the two interpreters
+//	in mipssim.cc: the switch in Machine::Execute and the threaded
+//	dispatch in Machine::RunThreaded.  Keeping one copy means the two 
+//	engines cannot drift apart.
+//
+//	This file is included in the middle of those routines, which 
+//	define three macros before including it:
+//
+//	OPCODE(op)	start of the handler for opCode "op"
+//	DONE		the instruction completed; retire it
+//	TRAP		an exception was raised; restart the instruction
+//
+//	The handlers work on "instr" and on the locals nextLoadReg, 
+//	nextLoadValue, pcAfter, sum, diff, tmp, value, rs, rt and imm.
+//	Unlisted opCodes are left to the includer.  Handlers that end
+//	without DONE fall through into the next one, as in the hardware
+//	(e.g. BGEZAL is BGEZ plus a link).
+//
+//	No include guard: it is meant to be included more than once.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+      OPCODE(OP_ADD)
+	sum = registers[instr->rs] + registers[instr->rt];
+	if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
+	    ((registers[instr->rs] ^ sum) & SIGN_BIT)) {
+	    RaiseException(OverflowException, 0);               // 溢出异常 @OF标记位的检测
+	    TRAP;
+	}
+	registers[instr->rd] = sum;
+	DONE;
+	
+      OPCODE(OP_ADDI)     // 立即数加法
+	sum = registers[instr->rs] + instr->extra;
+	if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT) &&
+	    ((instr->extra ^ sum) & SIGN_BIT)) {
+	    RaiseException(OverflowException, 0);
+	    TRAP;
+	}
+	registers[instr->rt] = sum;
+	DONE;
+	
+      OPCODE(OP_ADDIU)    // 立即数无符号加法
+	registers[instr->rt] = registers[instr->rs] + instr->extra;
+	DONE;
+	
+      OPCODE(OP_ADDU)     // 寄存器无符号加法
+	registers[instr->rd] = registers[instr->rs] + registers[instr->rt];
+	DONE;
+	
+      OPCODE(OP_AND)      // 按位与
+	registers[instr->rd] = registers[instr->rs] & registers[instr->rt];
+	DONE;
+	
+      OPCODE(OP_ANDI)     
+	registers[instr->rt] = registers[instr->rs] & (instr->extra & 0xffff);
+	DONE;
+	
+      OPCODE(OP_BEQ)      // Equal条件跳转
+	if (registers[instr->rs] == registers[instr->rt])
+	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+	DONE;
+	
+      OPCODE(OP_BGEZAL)   // 
+	registers[R31] = registers[NextPCReg] + 4;
+      OPCODE(OP_BGEZ)     // 
+	if (!(registers[instr->rs] & SIGN_BIT))
+	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+	DONE;
+	
+      OPCODE(OP_BGTZ)     
+	if (registers[instr->rs] > 0)
+	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+	DONE;
+	
+      OPCODE(OP_BLEZ)
+	if (registers[instr->rs] <= 0)
+	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+	DONE;
+	
+      OPCODE(OP_BLTZAL)   
+	registers[R31] = registers[NextPCReg] + 4;
+      OPCODE(OP_BLTZ)
+	if (registers[instr->rs] & SIGN_BIT)
+	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+	DONE;
+	
+      OPCODE(OP_BNE)      // Not Equal 跳转
+	if (registers[instr->rs] != registers[instr->rt])
+	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+	DONE;
+	
+      OPCODE(OP_DIV)
+	if (registers[instr->rt] == 0) {        // 除零          
+	    registers[LoReg] = 0;
+	    registers[HiReg] = 0;
+	} else {
+	    registers[LoReg] =  registers[instr->rs] / registers[instr->rt];
+	    registers[HiReg] = registers[instr->rs] % registers[instr->rt];
+	}
+	DONE;
+	
+      OPCODE(OP_DIVU)	  
+	  rs = (unsigned int) registers[instr->rs];
+	  rt = (unsigned int) registers[instr->rt];
+	  if (rt == 0) {
+	      registers[LoReg] = 0;
+	      registers[HiReg] = 0;
+	  } else {
+	      tmp = rs / rt;
+	      registers[LoReg] = (int) tmp;
+	      tmp = rs % rt;
+	      registers[HiReg] = (int) tmp;
+	  }
+	  DONE;
+	
+      OPCODE(OP_JAL)
+	registers[R31] = registers[NextPCReg] + 4;
+      OPCODE(OP_J)
+	pcAfter = (pcAfter & 0xf0000000) | IndexToAddr(instr->extra);
+	DONE;
+	
+      OPCODE(OP_JALR)
+	registers[instr->rd] = registers[NextPCReg] + 4;
+      OPCODE(OP_JR)
+	pcAfter = registers[instr->rs];
+	DONE;
+	
+      OPCODE(OP_LB)
+      OPCODE(OP_LBU)
+	tmp = registers[instr->rs] + instr->extra;
+	if (!ReadMem(tmp, 1, &value))
+	    TRAP;
+
+	if ((value & 0x80) && (instr->opCode == OP_LB))
+	    value |= 0xffffff00;
+	else
+	    value &= 0xff;
+	nextLoadReg = instr->rt;
+	nextLoadValue = value;
+	DONE;
+	
+      OPCODE(OP_LH)
+      OPCODE(OP_LHU)	  
+	tmp = registers[instr->rs] + instr->extra;
+	if (tmp & 0x1) {
+	    RaiseException(AddressErrorException, tmp);
+	    TRAP;
+	}
+	if (!ReadMem(tmp, 2, &value))
+	    TRAP;
+
+	if ((value & 0x8000) && (instr->opCode == OP_LH))
+	    value |= 0xffff0000;
+	else
+	    value &= 0xffff;
+	nextLoadReg = instr->rt;
+	nextLoadValue = value;
+	DONE;
+      	
+      OPCODE(OP_LUI)
+	DEBUG('m', "Executing: LUI r%d,%d\n", instr->rt, instr->extra);
+	registers[instr->rt] = instr->extra << 16;
+	DONE;
+	
+      OPCODE(OP_LW)
+	tmp = registers[instr->rs] + instr->extra;
+	if (tmp & 0x3) {
+	    RaiseException(AddressErrorException, tmp);
+	    TRAP;
+	}
+	if (!ReadMem(tmp, 4, &value))
+	    TRAP;
+	nextLoadReg = instr->rt;
+	nextLoadValue = value;
+	DONE;
+    	
+      OPCODE(OP_LWL)	  
+	tmp = registers[instr->rs] + instr->extra;
+
+	// ReadMem assumes all 4 byte requests are aligned on an even 
+	// word boundary.  Also, the little endian/big endian swap code would
+        // fail (I think) if the other cases are ever exercised.
+	ASSERT((tmp & 0x3) == 0);  
+
+	if (!ReadMem(tmp, 4, &value))
+	    TRAP;
+	if (registers[LoadReg] == instr->rt)
+	    nextLoadValue = registers[LoadValueReg];
+	else
+	    nextLoadValue = registers[instr->rt];
+	switch (tmp & 0x3) {
+	  case 0:
+	    nextLoadValue = value;
+	    break;
+	  case 1:
+	    nextLoadValue = (nextLoadValue & 0xff) | (value << 8);
+	    break;
+	  case 2:
+	    nextLoadValue = (nextLoadValue & 0xffff) | (value << 16);
+	    break;
+	  case 3:
+	    nextLoadValue = (nextLoadValue & 0xffffff) | (value << 24);
+	    break;
+	}
+	nextLoadReg = instr->rt;
+	DONE;
+      	
+      OPCODE(OP_LWR)
+	tmp = registers[instr->rs] + instr->extra;
+
+	// ReadMem assumes all 4 byte requests are aligned on an even 
+	// word boundary.  Also, the little endian/big endian swap code would
+        // fail (I think) if the other cases are ever exercised.
+	ASSERT((tmp & 0x3) == 0);  
+
+	if (!ReadMem(tmp, 4, &value))
+	    TRAP;
+	if (registers[LoadReg] == instr->rt)
+	    nextLoadValue = registers[LoadValueReg];
+	else
+	    nextLoadValue = registers[instr->rt];
+	switch (tmp & 0x3) {
+	  case 0:
+	    nextLoadValue = (nextLoadValue & 0xffffff00) |
+		((value >> 24) & 0xff);
+	    break;
+	  case 1:
+	    nextLoadValue = (nextLoadValue & 0xffff0000) |
+		((value >> 16) & 0xffff);
+	    break;
+	  case 2:
+	    nextLoadValue = (nextLoadValue & 0xff000000)
+		| ((value >> 8) & 0xffffff);
+	    break;
+	  case 3:
+	    nextLoadValue = value;
+	    break;
+	}
+	nextLoadReg = instr->rt;
+	DONE;
+    	
+      OPCODE(OP_MFHI)
+	registers[instr->rd] = registers[HiReg];
+	DONE;
+	
+      OPCODE(OP_MFLO)
+	registers[instr->rd] = registers[LoReg];
+	DONE;
+	
+      OPCODE(OP_MTHI)
+	registers[HiReg] = registers[instr->rs];
+	DONE;
+	
+      OPCODE(OP_MTLO)
+	registers[LoReg] = registers[instr->rs];
+	DONE;
+	
+      OPCODE(OP_MULT)
+	Mult(registers[instr->rs], registers[instr->rt], TRUE,
+	     &registers[HiReg], &registers[LoReg]);
+	DONE;
+	
+      OPCODE(OP_MULTU)
+	Mult(registers[instr->rs], registers[instr->rt], FALSE,
+	     &registers[HiReg], &registers[LoReg]);
+	DONE;
+	
+      OPCODE(OP_NOR)
+	registers[instr->rd] = ~(registers[instr->rs] | registers[instr->rt]);
+	DONE;
+	
+      OPCODE(OP_OR)
+	registers[instr->rd] = registers[instr->rs] | registers[instr->rs];
+	DONE;
+	
+      OPCODE(OP_ORI)
+	registers[instr->rt] = registers[instr->rs] | (instr->extra & 0xffff);
+	DONE;
+	
+      OPCODE(OP_SB)
+	if (!WriteMem((unsigned) 
+		(registers[instr->rs] + instr->extra), 1, registers[instr->rt]))
+	    TRAP;
+	DONE;
+	
+      OPCODE(OP_SH)
+	if (!WriteMem((unsigned) 
+		(registers[instr->rs] + instr->extra), 2, registers[instr->rt]))
+	    TRAP;
+	DONE;
+	
+      OPCODE(OP_SLL)
+	registers[instr->rd] = registers[instr->rt] << instr->extra;
+	DONE;
+	
+      OPCODE(OP_SLLV)
+	registers[instr->rd] = registers[instr->rt] <<
+	    (registers[instr->rs] & 0x1f);
+	DONE;
+	
+      OPCODE(OP_SLT)
+	if (registers[instr->rs] < registers[instr->rt])
+	    registers[instr->rd] = 1;
+	else
+	    registers[instr->rd] = 0;
+	DONE;
+	
+      OPCODE(OP_SLTI)
+	if (registers[instr->rs] < instr->extra)
+	    registers[instr->rt] = 1;
+	else
+	    registers[instr->rt] = 0;
+	DONE;
+	
+      OPCODE(OP_SLTIU)	  
+	rs = registers[instr->rs];
+	imm = instr->extra;
+	if (rs < imm)
+	    registers[instr->rt] = 1;
+	else
+	    registers[instr->rt] = 0;
+	DONE;
+      	
+      OPCODE(OP_SLTU)	  
+	rs = registers[instr->rs];
+	rt = registers[instr->rt];
+	if (rs < rt)
+	    registers[instr->rd] = 1;
+	else
+	    registers[instr->rd] = 0;
+	DONE;
+      	
+      OPCODE(OP_SRA)
+	registers[instr->rd] = registers[instr->rt] >> instr->extra;
+	DONE;
+	
+      OPCODE(OP_SRAV)
+	registers[instr->rd] = registers[instr->rt] >>
+	    (registers[instr->rs] & 0x1f);
+	DONE;
+	
+      OPCODE(OP_SRL)
+	tmp = registers[instr->rt];
+	tmp >>= instr->extra;
+	registers[instr->rd] = tmp;
+	DONE;
+	
+      OPCODE(OP_SRLV)
+	tmp = registers[instr->rt];
+	tmp >>= (registers[instr->rs] & 0x1f);
+	registers[instr->rd] = tmp;
+	DONE;
+	
+      OPCODE(OP_SUB)	  
+	diff = registers[instr->rs] - registers[instr->rt];
+	if (((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
+	    ((registers[instr->rs] ^ diff) & SIGN_BIT)) {
+	    RaiseException(OverflowException, 0);
+	    TRAP;
+	}
+	registers[instr->rd] = diff;
+	DONE;
+      	
+      OPCODE(OP_SUBU)
+	registers[instr->rd] = registers[instr->rs] - registers[instr->rt];
+	DONE;
+	
+      OPCODE(OP_SW)
+	if (!WriteMem((unsigned) 
+		(registers[instr->rs] + instr->extra), 4, registers[instr->rt]))
+	    TRAP;
+	DONE;
+	
+      OPCODE(OP_SWL)	  
+	tmp = registers[instr->rs] + instr->extra;
+
+	// The little endian/big endian swap code would
+        // fail (I think) if the other cases are ever exercised.
+	ASSERT((tmp & 0x3) == 0);  
+
+	if (!ReadMem((tmp & ~0x3), 4, &value))
+	    TRAP;
+	switch (tmp & 0x3) {
+	  case 0:
+	    value = registers[instr->rt];
+	    break;
+	  case 1:
+	    value = (value & 0xff000000) | ((registers[instr->rt] >> 8) &
+					    0xffffff);
+	    break;
+	  case 2:
+	    value = (value & 0xffff0000) | ((registers[instr->rt] >> 16) &
+					    0xffff);
+	    break;
+	  case 3:
+	    value = (value & 0xffffff00) | ((registers[instr->rt] >> 24) &
+					    0xff);
+	    break;
+	}
+	if (!WriteMem((tmp & ~0x3), 4, value))
+	    TRAP;
+	DONE;
+    	
+      OPCODE(OP_SWR)	  
+	tmp = registers[instr->rs] + instr->extra;
+
+	// The little endian/big endian swap code would
+        // fail (I think) if the other cases are ever exercised.
+	ASSERT((tmp & 0x3) == 0);  
+
+	if (!ReadMem((tmp & ~0x3), 4, &value))
+	    TRAP;
+	switch (tmp & 0x3) {
+	  case 0:
+	    value = (value & 0xffffff) | (registers[instr->rt] << 24);
+	    break;
+	  case 1:
+	    value = (value & 0xffff) | (registers[instr->rt] << 16);
+	    break;
+	  case 2:
+	    value = (value & 0xff) | (registers[instr->rt] << 8);
+	    break;
+	  case 3:
+	    value = registers[instr->rt];
+	    break;
+	}
+	if (!WriteMem((tmp & ~0x3), 4, value))
+	    TRAP;
+	DONE;
+    	
+      OPCODE(OP_SYSCALL)          // 系统调用
+	RaiseException(SyscallException, 0);
+	TRAP; 
+	
+      OPCODE(OP_XOR)
+	registers[instr->rd] = registers[instr->rs] ^ registers[instr->rt];
+	DONE;
+	
+      OPCODE(OP_XORI)
+	registers[instr->rt] = registers[instr->rs] ^ (instr->extra & 0xffff);
+	DONE;
+	
+      OPCODE(OP_RES)
+      OPCODE(OP_UNIMP)
+	RaiseException(IllegalInstrException, 0);
+	TRAP;
@@ -16,6 +16,7 @@
 #include "system.h"
 
 static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
+static void TraceInstruction(int pc, Instruction *instr);
 
 //----------------------------------------------------------------------
 // Machine::Run
@@ -24,26 +25,480 @@ static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 //
 //	This routine is re-entrant, in that it can be called multiple
 //	times concurrently -- one for each thread executing user code.
+//
+//	Instructions run in batches of Horizon() cycles, with one call
+//	to interrupt->OneTick per batch; each instruction costs the
+//	cycles the cost model gives its opCode (one, by default), and
+//	the batch ends with the instruction that reaches the horizon.
+//	unchargedCycles counts the batch so far; if an instruction
+//	traps, RaiseException charges those to the clock before entering
+//	the kernel, and the batch ends with a tick for the trapping
+//	instruction itself.  Either way, time and interrupts advance
+//	just as with one OneTick per instruction.
 //----------------------------------------------------------------------
 
 void
 Machine::Run()
 {
 
-    Instruction *instr = new Instruction;  // storage for decoded instruction
+    Instruction *instr;
+    int horizon, count;
     // 寄存器和页表等硬件状态已经被初始化
     if(DebugIsEnabled('m'))
         printf("Starting thread \"%s\" at time %d\n",
 	       currentThread->getName(), stats->totalTicks);
     interrupt->setStatus(UserMode);     // 进入用户态(not implemented)
+    if (engine == ThreadedEngine)
+	RunThreaded();			// never returns
+    else if (engine == BlockEngine || engine == JitEngine)
+	RunBlocks();			// never returns
+
+    instr = new Instruction;		// storage for decoded instruction
     for (;;) {
-        OneInstruction(instr);
-	interrupt->OneTick();
+	horizon = Horizon();
+	for (unchargedCycles = 0; unchargedCycles < horizon; )
+	    if (!OneInstruction(instr)) {
+		unchargedCycles = 1;	// the rest are already charged
+		break;
+	    }
+	count = unchargedCycles;
+	unchargedCycles = 0;
+	interrupt->OneTick(count);
 	if (singleStep && (runUntilTime <= stats->totalTicks))
 	  Debugger();
     }
 }
 
+//----------------------------------------------------------------------
+// Machine::Horizon
+// 	Return how many cycles may run before the next call to
+//	interrupt->OneTick: as many as it takes for the next interrupt
+//	to fall due, or just one (instruction) when single-stepping or
+//	tracing the clock tick by tick.
+//----------------------------------------------------------------------
+
+int
+Machine::Horizon()
+{
+    if (singleStep || DebugIsEnabled('i'))
+	return 1;
+    return interrupt->UserHorizon();
+}
+
+//----------------------------------------------------------------------
+// Machine::InitCostModel
+// 	The default cost model: every instruction takes one cycle, and
+//	TLB misses and page faults cost nothing beyond the time the
+//	kernel spends handling them -- Nachos' original timing.
+//----------------------------------------------------------------------
+
+void
+Machine::InitCostModel()
+{
+    if (opCycles == NULL)
+	opCycles = new int[MaxOpcode + 1];
+    for (int i = 0; i <= MaxOpcode; i++)
+	opCycles[i] = 1;
+    tlbMissCycles = pageFaultCycles = 0;
+}
+
+//----------------------------------------------------------------------
+// SameName
+// 	Return TRUE if "word" is the mnemonic at the start of "name" (up
+//	to the first blank), ignoring case.
+//----------------------------------------------------------------------
+
+static bool
+SameName(char *word, char *name)
+{
+    int i;
+
+    for (i = 0; (name[i] != '\0') && (name[i] != ' '); i++)
+	if (((word[i] >= 'a') && (word[i] <= 'z') ?
+		word[i] - 'a' + 'A' : word[i]) != name[i])
+	    return FALSE;
+    return word[i] == '\0';
+}
+
+//----------------------------------------------------------------------
+// Machine::LoadCostModel
+// 	Read the cost model from "fileName", given with "-cost".  Each
+//	line is a name and a number of cycles:
+//
+//		DIV 35		an opcode, by its mnemonic (at least 1)
+//		TLBMISS 20	the stall on a TLB miss (at least 0)
+//		PAGEFAULT 5000	the stall on touching an invalid page
+//
+//	Names are not case-sensitive, and '#' starts a comment.  Anything
+//	not mentioned keeps its default (see InitCostModel).
+//----------------------------------------------------------------------
+
+void
+Machine::LoadCostModel(char *fileName)
+{
+    int fd = OpenForReadWrite(fileName, TRUE);
+    int size = 0, allocated = 1024, n, lineNum, op, cycles;
+    char *text = new char[allocated], *line, *end, word[32], extra;
+
+    while ((n = ReadPartial(fd, text + size, allocated - size - 1)) > 0)
+	if ((size += n) == allocated - 1) {
+	    char *bigger = new char[allocated * 2];
+
+	    bcopy(text, bigger, size);
+	    delete [] text;
+	    text = bigger;
+	    allocated *= 2;
+	}
+    Close(fd);
+    text[size] = '\0';
+
+    for (line = text, lineNum = 1; *line != '\0'; line = end, lineNum++) {
+	for (end = line; (*end != '\0') && (*end != '\n'); end++)
+	    if (*end == '#')
+		*end = '\0';		// the rest of the line is ignored
+	if (*end == '\n')
+	    *end++ = '\0';
+	n = sscanf(line, "%31s %d %c", word, &cycles, &extra);
+	if (n <= 0)
+	    continue;			// a blank line
+	for (op = 1; op <= MaxOpcode; op++)
+	    if (SameName(word, opStrings[op].string))
+		break;
+	if ((n == 2) && (op <= MaxOpcode) && (cycles >= 1))
+	    opCycles[op] = cycles;
+	else if ((n == 2) && SameName(word, "TLBMISS") && (cycles >= 0))
+	    tlbMissCycles = cycles;
+	else if ((n == 2) && SameName(word, "PAGEFAULT") && (cycles >= 0))
+	    pageFaultCycles = cycles;
+	else {
+	    printf("%s, line %d: expected an instruction and its cycles\n",
+		   fileName, lineNum);
+	    fflush(stdout);
+	    ASSERT(FALSE);
+	}
+    }
+    delete [] text;
+    DEBUG('m', "Read the cost model in %s\n", fileName);
+}
+
+
+//----------------------------------------------------------------------
+// Machine::RunThreaded
+// 	The direct-threaded execution engine, selected with "-e threaded".
+//
+//	Same contract as the Run loop above -- fetch, execute, delayed
+//	load, PC advance, one tick -- but instead of re-entering
+//	OneInstruction and its switch for every instruction, each opcode
+//	handler jumps straight to the handler of the next one through a
+//	table of label addresses (a GNU C++ extension) indexed by the
+//	predecoded opCode.  The handlers are the ones Execute runs:
+//	both expand mipsops.h, with the labels and exits defined below.
+//----------------------------------------------------------------------
+
+void
+Machine::RunThreaded()
+{
+    void *dispatch[MaxOpcode + 1];
+    Instruction *instr = new Instruction;
+    int nextLoadReg, nextLoadValue, pcAfter;
+    int sum, diff, tmp, value;
+    unsigned int rs, rt, imm;
+    int horizon, count;
+
+    for (int i = 0; i <= MaxOpcode; i++)
+	dispatch[i] = &&do_bad;
+    dispatch[OP_ADD] = &&do_OP_ADD;		dispatch[OP_ADDI] = &&do_OP_ADDI;
+    dispatch[OP_ADDIU] = &&do_OP_ADDIU;		dispatch[OP_ADDU] = &&do_OP_ADDU;
+    dispatch[OP_AND] = &&do_OP_AND;		dispatch[OP_ANDI] = &&do_OP_ANDI;
+    dispatch[OP_BEQ] = &&do_OP_BEQ;		dispatch[OP_BGEZ] = &&do_OP_BGEZ;
+    dispatch[OP_BGEZAL] = &&do_OP_BGEZAL;	dispatch[OP_BGTZ] = &&do_OP_BGTZ;
+    dispatch[OP_BLEZ] = &&do_OP_BLEZ;		dispatch[OP_BLTZ] = &&do_OP_BLTZ;
+    dispatch[OP_BLTZAL] = &&do_OP_BLTZAL;	dispatch[OP_BNE] = &&do_OP_BNE;
+    dispatch[OP_DIV] = &&do_OP_DIV;		dispatch[OP_DIVU] = &&do_OP_DIVU;
+    dispatch[OP_J] = &&do_OP_J;			dispatch[OP_JAL] = &&do_OP_JAL;
+    dispatch[OP_JALR] = &&do_OP_JALR;		dispatch[OP_JR] = &&do_OP_JR;
+    dispatch[OP_LB] = &&do_OP_LB;		dispatch[OP_LBU] = &&do_OP_LBU;
+    dispatch[OP_LH] = &&do_OP_LH;		dispatch[OP_LHU] = &&do_OP_LHU;
+    dispatch[OP_LUI] = &&do_OP_LUI;		dispatch[OP_LW] = &&do_OP_LW;
+    dispatch[OP_LWL] = &&do_OP_LWL;		dispatch[OP_LWR] = &&do_OP_LWR;
+    dispatch[OP_MFHI] = &&do_OP_MFHI;		dispatch[OP_MFLO] = &&do_OP_MFLO;
+    dispatch[OP_MTHI] = &&do_OP_MTHI;		dispatch[OP_MTLO] = &&do_OP_MTLO;
+    dispatch[OP_MULT] = &&do_OP_MULT;		dispatch[OP_MULTU] = &&do_OP_MULTU;
+    dispatch[OP_NOR] = &&do_OP_NOR;		dispatch[OP_OR] = &&do_OP_OR;
+    dispatch[OP_ORI] = &&do_OP_ORI;		dispatch[OP_SB] = &&do_OP_SB;
+    dispatch[OP_SH] = &&do_OP_SH;		dispatch[OP_SLL] = &&do_OP_SLL;
+    dispatch[OP_SLLV] = &&do_OP_SLLV;		dispatch[OP_SLT] = &&do_OP_SLT;
+    dispatch[OP_SLTI] = &&do_OP_SLTI;		dispatch[OP_SLTIU] = &&do_OP_SLTIU;
+    dispatch[OP_SLTU] = &&do_OP_SLTU;		dispatch[OP_SRA] = &&do_OP_SRA;
+    dispatch[OP_SRAV] = &&do_OP_SRAV;		dispatch[OP_SRL] = &&do_OP_SRL;
+    dispatch[OP_SRLV] = &&do_OP_SRLV;		dispatch[OP_SUB] = &&do_OP_SUB;
+    dispatch[OP_SUBU] = &&do_OP_SUBU;		dispatch[OP_SW] = &&do_OP_SW;
+    dispatch[OP_SWL] = &&do_OP_SWL;		dispatch[OP_SWR] = &&do_OP_SWR;
+    dispatch[OP_XOR] = &&do_OP_XOR;		dispatch[OP_XORI] = &&do_OP_XORI;
+    dispatch[OP_SYSCALL] = &&do_OP_SYSCALL;	dispatch[OP_UNIMP] = &&do_OP_UNIMP;
+    dispatch[OP_RES] = &&do_OP_RES;
+
+// Fetch the next instruction and jump to its handler.  A handler either
+// falls into "retire" (instruction completed) or, after raising an
+// exception, into "tick" (the instruction will be restarted).  Batches
+// of instructions are charged as in Run.
+    horizon = Horizon();
+    unchargedCycles = 0;
+fetch:
+    if (!Fetch(registers[PCReg], instr))
+	goto tick;			// exception occurred
+    if (DebugIsEnabled('m'))
+	TraceInstruction(registers[PCReg], instr);
+    nextLoadReg = 0;
+    nextLoadValue = 0;
+    pcAfter = registers[NextPCReg] + 4;
+    goto *dispatch[(int) instr->opCode];
+
+#define OPCODE(op)	do_##op:
+#define DONE		goto retire
+#define TRAP		goto tick
+#include "mipsops.h"
+#undef OPCODE
+#undef DONE
+#undef TRAP
+
+do_bad:
+    ASSERT(FALSE);
+
+retire:
+    DelayedLoad(nextLoadReg, nextLoadValue);
+    registers[PrevPCReg] = registers[PCReg];
+    registers[PCReg] = registers[NextPCReg];
+    registers[NextPCReg] = pcAfter;
+    if (profile != NULL)
+	profile->Count(registers[PrevPCReg], instr->opCode, pcAfter);
+    unchargedCycles += opCycles[(int) instr->opCode];
+    userInstrs++;
+    if (unchargedCycles < horizon)
+	goto fetch;
+    count = unchargedCycles;
+    goto charge;
+
+tick:
+    count = 1;				// the rest are already charged
+charge:
+    unchargedCycles = 0;
+    interrupt->OneTick(count);
+    if (singleStep && (runUntilTime <= stats->totalTicks))
+	Debugger();
+    horizon = Horizon();
+    goto fetch;
+}
+
+//----------------------------------------------------------------------
+// Machine::RunBlocks
+// 	The basic block execution engine, selected with "-e block".
+//
+//	Each dispatch looks up (or translates) the block starting at the
+//	current PC and runs it.  Instructions are charged in batches as
+//	in Run, and a block is cut short where its batch ends, so
+//	interrupts are taken after the same instruction as with the
+//	reference loop.  The one difference is that the PC is translated
+//	once per block rather than per instruction, so TLB hit counts
+//	and LRU stamps are coarser.
+//	Single-stepping, 'm' tracing and profiling fall back to 
+//	OneInstruction.
+//
+//	"-e jit" also runs this loop; ExecuteBlock then hands hot blocks
+//	to the code generated in jit.cc.
+//----------------------------------------------------------------------
+
+void
+Machine::RunBlocks()
+{
+    Instruction *instr = new Instruction;	// for the fallback path
+    TranslatedBlock *block;
+    int horizon, count;
+
+    for (;;) {
+	if (singleStep || DebugIsEnabled('m') || (profile != NULL)) {
+	    unchargedCycles = 0;
+	    count = OneInstruction(instr) ? unchargedCycles : 1;
+	    unchargedCycles = 0;
+	    interrupt->OneTick(count);
+	    if (singleStep && (runUntilTime <= stats->totalTicks))
+		Debugger();
+	    continue;
+	}
+	horizon = Horizon();
+	for (unchargedCycles = 0; unchargedCycles < horizon; ) {
+	    block = FindBlock(registers[PCReg]);
+	    if (block == NULL || !ExecuteBlock(block, horizon)) {
+		unchargedCycles = 1;	// the rest are already charged
+		break;
+	    }
+	}
+	count = unchargedCycles;
+	unchargedCycles = 0;
+	interrupt->OneTick(count);
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::RunDetached
+// 	Run the user program loaded into this core for up to "budget"
+//	cycles, on a host thread of its own, without calling into
+//	the kernel: no ticks, no interrupts, no exceptions.  We stop in 
+//	front of the first instruction that would trap, with the registers
+//	as they were before it; the kernel takes the trap when it runs
+//	the thread itself and executes that instruction again.
+//
+//	The block and JIT engines run as usual; the threaded one, which 
+//	ticks the clock itself, falls back to OneInstruction.
+//
+//	Returns the number of cycles completed; the instructions are
+//	counted in userInstrs.
+//----------------------------------------------------------------------
+
+int
+Machine::RunDetached(int budget)
+{
+    Instruction instr;
+    TranslatedBlock *block;
+
+    ASSERT(detached);
+    if (singleStep || DebugIsEnabled('m') || DebugIsEnabled('a')
+	    || (profile != NULL))
+	return 0;			// the kernel must see each one
+    FlushSoftTLB();			// the kernel may have changed mappings
+    trapped = FALSE;
+    for (unchargedCycles = 0; unchargedCycles < budget && !trapped; ) {
+	if (engine == BlockEngine || engine == JitEngine) {
+	    block = FindBlock(registers[PCReg]);
+	    if (block != NULL)
+		(void) ExecuteBlock(block, budget);
+	} else
+	    (void) OneInstruction(&instr);
+    }
+    return unchargedCycles;
+}
+
+//----------------------------------------------------------------------
+// IsBranch, IsTrap [helpers]
+// 	Classify an opCode for block translation.  A block ends after the
+//	delay slot of a branch or jump, and right after an instruction
+//	that always traps to the kernel.  The profiler uses them too.
+//----------------------------------------------------------------------
+
+bool
+IsBranch(int opCode)
+{
+    switch (opCode) {
+      case OP_BEQ: case OP_BNE: case OP_BGEZ: case OP_BGEZAL:
+      case OP_BGTZ: case OP_BLEZ: case OP_BLTZ: case OP_BLTZAL:
+      case OP_J: case OP_JAL: case OP_JALR: case OP_JR:
+	return TRUE;
+      default:
+	return FALSE;
+    }
+}
+
+bool
+IsTrap(int opCode)
+{
+    return (opCode == OP_SYSCALL) || (opCode == OP_RES) || 
+	(opCode == OP_UNIMP);
+}
+
+//----------------------------------------------------------------------
+// Machine::FindBlock
+// 	Return the translated block starting at virtual address "addr" in
+//	the current address space, translating it from memory if the cache
+//	holds no valid copy.
+//
+//	The address is translated like an instruction fetch, so page
+//	faults and TLB misses are raised here; then we return NULL and the
+//	caller restarts once the kernel has handled it.
+//----------------------------------------------------------------------
+
+TranslatedBlock *
+Machine::FindBlock(int addr)
+{
+    ExceptionType exception;
+    int physicalAddress, frame, slot, i;
+    TranslatedBlock *block;
+
+    exception = Translate(addr, &physicalAddress, 4, FALSE);
+    if (exception != NoException) {
+	RaiseException(exception, addr);
+	return NULL;
+    }
+    frame = physicalAddress / PageSize;
+    block = &blockCache[((unsigned) addr / 4 
+			 ^ (unsigned long) pageTable / sizeof(TranslationEntry))
+			% NumBlocks];
+    if (block->space == pageTable && block->vaddr == addr 
+	    && block->frame == frame
+	    && block->generation == frameGeneration[frame])
+	return block;
+
+    // Miss: translate from the predecode cache up to the end of the 
+    // block, or the end of the page, whichever comes first.
+    DEBUG('a', "Translating block at VA 0x%x\n", addr);
+    block->space = pageTable;
+    block->vaddr = addr;
+    block->frame = frame;
+    block->generation = frameGeneration[frame];
+    block->executions = 0;
+    block->native = NULL;
+    slot = physicalAddress / 4;
+    for (i = 0; i < MaxBlockInstrs; ) {
+	if (!decoded[slot]) {
+	    decodeCache[slot].value = WordToHost(*(unsigned int *) 
+						 &mainMemory[slot * 4]);
+	    decodeCache[slot].Decode();
+	    decoded[slot] = TRUE;
+	}
+	block->code[i++] = decodeCache[slot++];
+	if (IsTrap(block->code[i - 1].opCode))
+	    break;
+	if (i > 1 && IsBranch(block->code[i - 2].opCode))
+	    break;			// that was the delay slot
+	if ((slot * 4) % PageSize == 0)
+	    break;			// next word is on another page
+    }
+    block->numInstrs = i;
+    return block;
+}
+
+//----------------------------------------------------------------------
+// Machine::ExecuteBlock
+// 	Execute "block", which starts at the current PC, one instruction
+//	at a time through Execute.  We leave the block early when control
+//	goes elsewhere, when a store has just invalidated the block's own
+//	page, or when unchargedCycles reaches "horizon" (the end of the
+//	batch; see Machine::Run).
+//
+//	Returns FALSE if an instruction raised an exception; the block
+//	may be gone by then.
+//----------------------------------------------------------------------
+
+bool
+Machine::ExecuteBlock(TranslatedBlock *block, int horizon)
+{
+    int i = 0;
+
+    if (engine == JitEngine) {		// may complete part or all of it
+	i = ExecuteNative(block, horizon - unchargedCycles);
+	if (i > 0) {
+	    unchargedCycles += block->nativeCycles;
+	    userInstrs += i;
+	}
+    }
+    for (; i < block->numInstrs && unchargedCycles < horizon; i++) {
+	if (registers[PCReg] != block->vaddr + 4 * i
+		|| block->generation != frameGeneration[block->frame])
+	    break;
+	if (!Execute(&block->code[i]))
+	    return FALSE;
+    }
+    return TRUE;
+}
 
 //----------------------------------------------------------------------
 // TypeToReg [helper]
@@ -67,6 +522,23 @@ TypeToReg(RegType reg, Instruction *instr)
     }
 }
 
+//----------------------------------------------------------------------
+// TraceInstruction [helper]
+// 	Print the instruction about to execute at "pc", for debug flag 'm'.
+//----------------------------------------------------------------------
+
+static void
+TraceInstruction(int pc, Instruction *instr)
+{
+    struct OpString *str = &opStrings[instr->opCode];
+
+    ASSERT(instr->opCode <= MaxOpcode);
+    printf("At PC = 0x%x: ", pc);
+    printf(str->string, TypeToReg(str->args[0], instr), 
+	    TypeToReg(str->args[1], instr), TypeToReg(str->args[2], instr));
+    printf("\n");
+}
+
 //----------------------------------------------------------------------
 // Machine::OneInstruction
 // 	Execute one instruction from a user-level program
@@ -90,32 +562,45 @@ TypeToReg(RegType reg, Instruction *instr)
 //	and the register set.
 //      
 //      取指->译码->执行
+//
+//	Returns FALSE if the instruction raised an exception.
 //----------------------------------------------------------------------
 
-void
+bool
 Machine::OneInstruction(Instruction *instr)
 {
-    int raw;
+    // Fetch instruction 4字节, decoded at most once per load of the page
+    if (!Fetch(registers[PCReg], instr))
+	return FALSE;		// exception occurred
+
+    if (DebugIsEnabled('m'))
+	TraceInstruction(registers[PCReg], instr);
+    if (!Execute(instr))
+	return FALSE;
+    if (profile != NULL)
+	profile->Count(registers[PrevPCReg], instr->opCode, 
+		       registers[NextPCReg]);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::Execute
+// 	Execute the already fetched and decoded instruction "instr", which
+//	must be the one at registers[PCReg]: perform the operation, apply
+//	any pending delayed load and advance the program counters.
+//
+//	Returns FALSE if the instruction raised an exception instead of
+//	completing; the registers are then left for the exception handler,
+//	exactly as OneInstruction always has.
+//----------------------------------------------------------------------
+
+bool
+Machine::Execute(Instruction *instr)
+{
     int nextLoadReg = 0; 	
     int nextLoadValue = 0; 	// record delayed load operation, to apply
 				// in the future
                                 
-    // Fetch instruction 4字节
-    if (!machine->ReadMem(registers[PCReg], 4, &raw))
-	return;			// exception occurred
-    instr->value = raw; // 4-byte 指令编码
-    instr->Decode();
-
-    if (DebugIsEnabled('m')) {
-       struct OpString *str = &opStrings[instr->opCode];
-
-       ASSERT(instr->opCode <= MaxOpcode);
-       printf("At PC = 0x%x: ", registers[PCReg]);
-       printf(str->string, TypeToReg(str->args[0], instr), 
-		TypeToReg(str->args[1], instr), TypeToReg(str->args[2], instr));
-       printf("\n");
-       }
-    
     // 计算下一个PC 但确保本条指令没有异常后才会更新PC
     int pcAfter = registers[NextPCReg] + 4; // 下一条PC
     int sum, diff, tmp, value;
@@ -124,431 +609,13 @@ Machine::OneInstruction(Instruction *instr)
     // Execute the instruction (cf. Kane's book)
     switch (instr->opCode) {
 	
-      case OP_ADD:
-	sum = registers[instr->rs] + registers[instr->rt];
-	if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
-	    ((registers[instr->rs] ^ sum) & SIGN_BIT)) {
-	    RaiseException(OverflowException, 0);               // 溢出异常 @OF标记位的检测
-	    return;
-	}
-	registers[instr->rd] = sum;
-	break;
-	
-      case OP_ADDI:     // 立即数加法
-	sum = registers[instr->rs] + instr->extra;
-	if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT) &&
-	    ((instr->extra ^ sum) & SIGN_BIT)) {
-	    RaiseException(OverflowException, 0);
-	    return;
-	}
-	registers[instr->rt] = sum;
-	break;
-	
-      case OP_ADDIU:    // 立即数无符号加法
-	registers[instr->rt] = registers[instr->rs] + instr->extra;
-	break;
-	
-      case OP_ADDU:     // 寄存器无符号加法
-	registers[instr->rd] = registers[instr->rs] + registers[instr->rt];
-	break;
-	
-      case OP_AND:      // 按位与
-	registers[instr->rd] = registers[instr->rs] & registers[instr->rt];
-	break;
-	
-      case OP_ANDI:     
-	registers[instr->rt] = registers[instr->rs] & (instr->extra & 0xffff);
-	break;
-	
-      case OP_BEQ:      // Equal条件跳转
-	if (registers[instr->rs] == registers[instr->rt])
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
-	break;
-	
-      case OP_BGEZAL:   // 
-	registers[R31] = registers[NextPCReg] + 4;
-      case OP_BGEZ:     // 
-	if (!(registers[instr->rs] & SIGN_BIT))
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
-	break;
-	
-      case OP_BGTZ:     
-	if (registers[instr->rs] > 0)
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
-	break;
-	
-      case OP_BLEZ:
-	if (registers[instr->rs] <= 0)
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
-	break;
-	
-      case OP_BLTZAL:   
-	registers[R31] = registers[NextPCReg] + 4;
-      case OP_BLTZ:
-	if (registers[instr->rs] & SIGN_BIT)
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
-	break;
-	
-      case OP_BNE:      // Not Equal 跳转
-	if (registers[instr->rs] != registers[instr->rt])
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
-	break;
-	
-      case OP_DIV:
-	if (registers[instr->rt] == 0) {        // 除零          
-	    registers[LoReg] = 0;
-	    registers[HiReg] = 0;
-	} else {
-	    registers[LoReg] =  registers[instr->rs] / registers[instr->rt];
-	    registers[HiReg] = registers[instr->rs] % registers[instr->rt];
-	}
-	break;
-	
-      case OP_DIVU:	  
-	  rs = (unsigned int) registers[instr->rs];
-	  rt = (unsigned int) registers[instr->rt];
-	  if (rt == 0) {
-	      registers[LoReg] = 0;
-	      registers[HiReg] = 0;
-	  } else {
-	      tmp = rs / rt;
-	      registers[LoReg] = (int) tmp;
-	      tmp = rs % rt;
-	      registers[HiReg] = (int) tmp;
-	  }
-	  break;
-	
-      case OP_JAL:
-	registers[R31] = registers[NextPCReg] + 4;
-      case OP_J:
-	pcAfter = (pcAfter & 0xf0000000) | IndexToAddr(instr->extra);
-	break;
-	
-      case OP_JALR:
-	registers[instr->rd] = registers[NextPCReg] + 4;
-      case OP_JR:
-	pcAfter = registers[instr->rs];
-	break;
-	
-      case OP_LB:
-      case OP_LBU:
-	tmp = registers[instr->rs] + instr->extra;
-	if (!machine->ReadMem(tmp, 1, &value))
-	    return;
-
-	if ((value & 0x80) && (instr->opCode == OP_LB))
-	    value |= 0xffffff00;
-	else
-	    value &= 0xff;
-	nextLoadReg = instr->rt;
-	nextLoadValue = value;
-	break;
-	
-      case OP_LH:
-      case OP_LHU:	  
-	tmp = registers[instr->rs] + instr->extra;
-	if (tmp & 0x1) {
-	    RaiseException(AddressErrorException, tmp);
-	    return;
-	}
-	if (!machine->ReadMem(tmp, 2, &value))
-	    return;
-
-	if ((value & 0x8000) && (instr->opCode == OP_LH))
-	    value |= 0xffff0000;
-	else
-	    value &= 0xffff;
-	nextLoadReg = instr->rt;
-	nextLoadValue = value;
-	break;
-      	
-      case OP_LUI:
-	DEBUG('m', "Executing: LUI r%d,%d\n", instr->rt, instr->extra);
-	registers[instr->rt] = instr->extra << 16;
-	break;
-	
-      case OP_LW:
-	tmp = registers[instr->rs] + instr->extra;
-	if (tmp & 0x3) {
-	    RaiseException(AddressErrorException, tmp);
-	    return;
-	}
-	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
-	nextLoadReg = instr->rt;
-	nextLoadValue = value;
-	break;
-    	
-      case OP_LWL:	  
-	tmp = registers[instr->rs] + instr->extra;
-
-	// ReadMem assumes all 4 byte requests are aligned on an even 
-	// word boundary.  Also, the little endian/big endian swap code would
-        // fail (I think) if the other cases are ever exercised.
-	ASSERT((tmp & 0x3) == 0);  
-
-	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
-	if (registers[LoadReg] == instr->rt)
-	    nextLoadValue = registers[LoadValueReg];
-	else
-	    nextLoadValue = registers[instr->rt];
-	switch (tmp & 0x3) {
-	  case 0:
-	    nextLoadValue = value;
-	    break;
-	  case 1:
-	    nextLoadValue = (nextLoadValue & 0xff) | (value << 8);
-	    break;
-	  case 2:
-	    nextLoadValue = (nextLoadValue & 0xffff) | (value << 16);
-	    break;
-	  case 3:
-	    nextLoadValue = (nextLoadValue & 0xffffff) | (value << 24);
-	    break;
-	}
-	nextLoadReg = instr->rt;
-	break;
-      	
-      case OP_LWR:
-	tmp = registers[instr->rs] + instr->extra;
-
-	// ReadMem assumes all 4 byte requests are aligned on an even 
-	// word boundary.  Also, the little endian/big endian swap code would
-        // fail (I think) if the other cases are ever exercised.
-	ASSERT((tmp & 0x3) == 0);  
-
-	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
-	if (registers[LoadReg] == instr->rt)
-	    nextLoadValue = registers[LoadValueReg];
-	else
-	    nextLoadValue = registers[instr->rt];
-	switch (tmp & 0x3) {
-	  case 0:
-	    nextLoadValue = (nextLoadValue & 0xffffff00) |
-		((value >> 24) & 0xff);
-	    break;
-	  case 1:
-	    nextLoadValue = (nextLoadValue & 0xffff0000) |
-		((value >> 16) & 0xffff);
-	    break;
-	  case 2:
-	    nextLoadValue = (nextLoadValue & 0xff000000)
-		| ((value >> 8) & 0xffffff);
-	    break;
-	  case 3:
-	    nextLoadValue = value;
-	    break;
-	}
-	nextLoadReg = instr->rt;
-	break;
-    	
-      case OP_MFHI:
-	registers[instr->rd] = registers[HiReg];
-	break;
-	
-      case OP_MFLO:
-	registers[instr->rd] = registers[LoReg];
-	break;
-	
-      case OP_MTHI:
-	registers[HiReg] = registers[instr->rs];
-	break;
-	
-      case OP_MTLO:
-	registers[LoReg] = registers[instr->rs];
-	break;
-	
-      case OP_MULT:
-	Mult(registers[instr->rs], registers[instr->rt], TRUE,
-	     &registers[HiReg], &registers[LoReg]);
-	break;
-	
-      case OP_MULTU:
-	Mult(registers[instr->rs], registers[instr->rt], FALSE,
-	     &registers[HiReg], &registers[LoReg]);
-	break;
-	
-      case OP_NOR:
-	registers[instr->rd] = ~(registers[instr->rs] | registers[instr->rt]);
-	break;
-	
-      case OP_OR:
-	registers[instr->rd] = registers[instr->rs] | registers[instr->rs];
-	break;
-	
-      case OP_ORI:
-	registers[instr->rt] = registers[instr->rs] | (instr->extra & 0xffff);
-	break;
-	
-      case OP_SB:
-	if (!machine->WriteMem((unsigned) 
-		(registers[instr->rs] + instr->extra), 1, registers[instr->rt]))
-	    return;
-	break;
-	
-      case OP_SH:
-	if (!machine->WriteMem((unsigned) 
-		(registers[instr->rs] + instr->extra), 2, registers[instr->rt]))
-	    return;
-	break;
-	
-      case OP_SLL:
-	registers[instr->rd] = registers[instr->rt] << instr->extra;
-	break;
-	
-      case OP_SLLV:
-	registers[instr->rd] = registers[instr->rt] <<
-	    (registers[instr->rs] & 0x1f);
-	break;
-	
-      case OP_SLT:
-	if (registers[instr->rs] < registers[instr->rt])
-	    registers[instr->rd] = 1;
-	else
-	    registers[instr->rd] = 0;
-	break;
-	
-      case OP_SLTI:
-	if (registers[instr->rs] < instr->extra)
-	    registers[instr->rt] = 1;
-	else
-	    registers[instr->rt] = 0;
-	break;
-	
-      case OP_SLTIU:	  
-	rs = registers[instr->rs];
-	imm = instr->extra;
-	if (rs < imm)
-	    registers[instr->rt] = 1;
-	else
-	    registers[instr->rt] = 0;
-	break;
-      	
-      case OP_SLTU:	  
-	rs = registers[instr->rs];
-	rt = registers[instr->rt];
-	if (rs < rt)
-	    registers[instr->rd] = 1;
-	else
-	    registers[instr->rd] = 0;
-	break;
-      	
-      case OP_SRA:
-	registers[instr->rd] = registers[instr->rt] >> instr->extra;
-	break;
-	
-      case OP_SRAV:
-	registers[instr->rd] = registers[instr->rt] >>
-	    (registers[instr->rs] & 0x1f);
-	break;
-	
-      case OP_SRL:
-	tmp = registers[instr->rt];
-	tmp >>= instr->extra;
-	registers[instr->rd] = tmp;
-	break;
-	
-      case OP_SRLV:
-	tmp = registers[instr->rt];
-	tmp >>= (registers[instr->rs] & 0x1f);
-	registers[instr->rd] = tmp;
-	break;
-	
-      case OP_SUB:	  
-	diff = registers[instr->rs] - registers[instr->rt];
-	if (((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
-	    ((registers[instr->rs] ^ diff) & SIGN_BIT)) {
-	    RaiseException(OverflowException, 0);
-	    return;
-	}
-	registers[instr->rd] = diff;
-	break;
-      	
-      case OP_SUBU:
-	registers[instr->rd] = registers[instr->rs] - registers[instr->rt];
-	break;
-	
-      case OP_SW:
-	if (!machine->WriteMem((unsigned) 
-		(registers[instr->rs] + instr->extra), 4, registers[instr->rt]))
-	    return;
-	break;
-	
-      case OP_SWL:	  
-	tmp = registers[instr->rs] + instr->extra;
-
-	// The little endian/big endian swap code would
-        // fail (I think) if the other cases are ever exercised.
-	ASSERT((tmp & 0x3) == 0);  
-
-	if (!machine->ReadMem((tmp & ~0x3), 4, &value))
-	    return;
-	switch (tmp & 0x3) {
-	  case 0:
-	    value = registers[instr->rt];
-	    break;
-	  case 1:
-	    value = (value & 0xff000000) | ((registers[instr->rt] >> 8) &
-					    0xffffff);
-	    break;
-	  case 2:
-	    value = (value & 0xffff0000) | ((registers[instr->rt] >> 16) &
-					    0xffff);
-	    break;
-	  case 3:
-	    value = (value & 0xffffff00) | ((registers[instr->rt] >> 24) &
-					    0xff);
-	    break;
-	}
-	if (!machine->WriteMem((tmp & ~0x3), 4, value))
-	    return;
-	break;
-    	
-      case OP_SWR:	  
-	tmp = registers[instr->rs] + instr->extra;
-
-	// The little endian/big endian swap code would
-        // fail (I think) if the other cases are ever exercised.
-	ASSERT((tmp & 0x3) == 0);  
-
-	if (!machine->ReadMem((tmp & ~0x3), 4, &value))
-	    return;
-	switch (tmp & 0x3) {
-	  case 0:
-	    value = (value & 0xffffff) | (registers[instr->rt] << 24);
-	    break;
-	  case 1:
-	    value = (value & 0xffff) | (registers[instr->rt] << 16);
-	    break;
-	  case 2:
-	    value = (value & 0xff) | (registers[instr->rt] << 8);
-	    break;
-	  case 3:
-	    value = registers[instr->rt];
-	    break;
-	}
-	if (!machine->WriteMem((tmp & ~0x3), 4, value))
-	    return;
-	break;
-    	
-      case OP_SYSCALL:          // 系统调用
-	RaiseException(SyscallException, 0);
-	return; 
-	
-      case OP_XOR:
-	registers[instr->rd] = registers[instr->rs] ^ registers[instr->rt];
-	break;
-	
-      case OP_XORI:
-	registers[instr->rt] = registers[instr->rs] ^ (instr->extra & 0xffff);
-	break;
-	
-      case OP_RES:
-      case OP_UNIMP:
-	RaiseException(IllegalInstrException, 0);
-	return;
+#define OPCODE(op)	case op:
+#define DONE		break
+#define TRAP		return FALSE
+#include "mipsops.h"
+#undef OPCODE
+#undef DONE
+#undef TRAP
 	
       default:
 	ASSERT(FALSE);
@@ -564,7 +631,49 @@ Machine::OneInstruction(Instruction *instr)
 						// are jumping into lala-land
     registers[PCReg] = registers[NextPCReg];
     registers[NextPCReg] = pcAfter;             // 
+    unchargedCycles += opCycles[(int) instr->opCode];
+    userInstrs++;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::Fetch
+// 	Fetch the instruction at virtual address "addr" into "instr".
+//
+//	The address is translated exactly as ReadMem would (so use bits,
+//	TLB statistics and faults are unchanged), but the decoded form is
+//	taken from the predecode cache, indexed by physical word.  Only a
+//	miss reads the raw word and runs Instruction::Decode.
+//
+//	Returns FALSE if the translation raised an exception.
+//----------------------------------------------------------------------
 
+bool
+Machine::Fetch(int addr, Instruction *instr)
+{
+    ExceptionType exception;
+    int physicalAddress;
+    int slot;
+    char *host = SoftTranslate(addr, 4, FALSE);
+
+    if (host != NULL)
+	physicalAddress = host - mainMemory;
+    else {
+	exception = Translate(addr, &physicalAddress, 4, FALSE);
+	if (exception != NoException) {
+	    RaiseException(exception, addr);
+	    return FALSE;
+	}
+    }
+    slot = physicalAddress / 4;
+    if (!decoded[slot]) {
+	decodeCache[slot].value = 
+		WordToHost(*(unsigned int *) &mainMemory[physicalAddress]);
+	decodeCache[slot].Decode();
+	decoded[slot] = TRUE;
+    }
+    *instr = decodeCache[slot];
+    return TRUE;
 }
 
 void
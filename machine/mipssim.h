@@ -227,6 +227,14 @@ static struct OpString opStrings[] = {
 	{"Reserved", {NONE, NONE, NONE}}
       };
 
+/*
+ * Classify an opCode: branches and jumps (which have a delay slot),
+ * and instructions that always trap.  Defined in mipssim.cc.
+ */
+
+extern bool IsBranch(int opCode);
+extern bool IsTrap(int opCode);
+
 #endif // MIPSSIM_H
 
 
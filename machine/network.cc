@@ -65,12 +65,12 @@ Network::CheckPktAvail()
 
     if (inHdr.length != 0) 	// do nothing if packet is already buffered
 	return;		
-    if (!PollSocket(sock)) 	// do nothing if no packet to be read
+    if (!traceLog->PollSocket(sock)) 	// do nothing if no packet to be read
 	return;
 
     // otherwise, read packet in
     char *buffer = new char[MaxWireSize];
-    ReadFromSocket(sock, buffer, MaxWireSize);
+    traceLog->ReadFromSocket(sock, buffer, MaxWireSize);
 
     // divide packet into header and data
     inHdr = *(PacketHeader *)buffer;
@@ -113,7 +113,7 @@ Network::Send(PacketHeader hdr, char* data)
 
     interrupt->Schedule(NetworkSendDone, (int)this, NetworkTime, NetworkSendInt);
 
-    if (Random() % 100 >= chanceToWork * 100) { // emulate a lost packet
+    if (traceLog->Random() % 100 >= chanceToWork * 100) { // emulate a lost packet
 	DEBUG('n', "oops, lost it!\n");
 	return;
     }
@@ -122,7 +122,7 @@ Network::Send(PacketHeader hdr, char* data)
     char *buffer = new char[MaxWireSize];
     *(PacketHeader *)buffer = hdr;
     bcopy(data, buffer + sizeof(PacketHeader), hdr.length);
-    SendToSocket(sock, buffer, MaxWireSize, toName);
+    traceLog->SendToSocket(sock, buffer, MaxWireSize, toName);
     delete []buffer;
 }
 
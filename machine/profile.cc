@@ -0,0 +1,359 @@
+// profile.cc
+//	Routines to collect and report the instruction profile of a user
+//	program.
+//
+//	A dump consists of two files, named after the executable and the
+//	process id:
+//
+//	"program"."pid".prof -- the raw histogram, as host-order words:
+//		a header { ProfileMagic, words in the address space, pid,
+//		# records } followed by one record { vaddr, executions,
+//		times taken (branches only), opCode } for every
+//		instruction that ran, in address order.
+//
+//	"program"."pid".txt -- a report: totals, the hottest basic
+//		blocks and, if we found symbols, time per procedure.
+//
+//	Basic blocks are recovered from the histogram itself: a block is
+//	a run of consecutive instructions executed equally often, ending
+//	after the delay slot of a branch or jump, or after a syscall.
+//
+//	Addresses are symbolized with the external symbols of the COFF
+//	file that coff2noff turned into the executable, looked for as
+//	"program".coff.  Without it the report just shows addresses.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "profile.h"
+#include "machine.h"
+#include "mipssim.h"
+#include "coff.h"
+#include <string.h>
+
+// The parts of the MIPS symbolic header (HDRR) and of an external
+// symbol (EXTR) that we use; see <syms.h> on a MIPS host.  Offsets
+// are in bytes.
+
+#define SymMagic	0x7009		// HDRR magic
+#define SymHeaderSize	96		// sizeof(HDRR)
+#define SymIssExtMax	64		// size of the external string space
+#define SymCbSsExtOffset 68		// file offset of that string space
+#define SymIextMax	88		// # external symbols
+#define SymCbExtOffset	92		// file offset of the external symbols
+
+#define ExtSize		16		// sizeof(EXTR)
+#define ExtIss		4		// offset of the name in string space
+#define ExtValue	8		// address
+#define ExtBits		12		// st:6, sc:5, reserved:1, index:20
+
+#define StGlobal	1		// symbol types we keep
+#define StLabel		2
+#define StProc		6
+#define StStaticProc	14
+#define ScText		1		// storage class: in .text
+
+// A basic block recovered from the histogram, while reporting.
+
+class ProfileBlock {
+  public:
+    int first, last;		// slots of its first and last instruction
+    unsigned int runs;		// times it was entered
+    unsigned int instrs;	// instructions executed in it
+};
+
+//----------------------------------------------------------------------
+// WordAt [helper]
+// 	Return the little-endian COFF word at "offset" in "buffer".
+//----------------------------------------------------------------------
+
+static int
+WordAt(char *buffer, int offset)
+{
+    return WordToHost(*(unsigned int *) (buffer + offset));
+}
+
+//----------------------------------------------------------------------
+// WriteLine [helper]
+// 	Write a line of the text report.
+//----------------------------------------------------------------------
+
+static void
+WriteLine(int fd, char *line)
+{
+    WriteFile(fd, line, strlen(line));
+}
+
+//----------------------------------------------------------------------
+// Profile::Profile
+// 	Initialize an empty profile for a user program.
+//
+//	"executable" -- the program's file, whose name we keep for the dump
+//	"size" -- bytes in the program's address space
+//----------------------------------------------------------------------
+
+Profile::Profile(char *executable, int size)
+{
+    program = new char[strlen(executable) + 1];
+    strcpy(program, executable);
+    numSlots = size / 4;
+    counts = new unsigned int[numSlots];
+    taken = new unsigned int[numSlots];
+    ops = new char[numSlots];
+    for (int i = 0; i < numSlots; i++) {
+	counts[i] = taken[i] = 0;
+	ops[i] = OP_UNIMP;
+    }
+    symbols = NULL;
+    numSymbols = 0;
+    symbolNames = NULL;
+    LoadSymbols();
+}
+
+//----------------------------------------------------------------------
+// Profile::~Profile
+// 	De-allocate a profile.
+//----------------------------------------------------------------------
+
+Profile::~Profile()
+{
+    delete [] program;
+    delete [] counts;
+    delete [] taken;
+    delete [] ops;
+    delete [] symbols;
+    delete [] symbolNames;
+}
+
+//----------------------------------------------------------------------
+// Profile::LoadSymbols
+// 	Read the procedures of the program from the external symbols
+//	of "program".coff, if that file exists and has a symbol table.
+//----------------------------------------------------------------------
+
+void
+Profile::LoadSymbols()
+{
+    char *name = new char[strlen(program) + 6];
+    struct filehdr fileh;
+    char header[SymHeaderSize];
+    char *externals;
+    int fd, numExternals, stringSize, bits, i;
+
+    sprintf(name, "%s.coff", program);
+    fd = OpenForReadWrite(name, FALSE);
+    delete [] name;
+    if (fd < 0)
+	return;
+    if ((ReadPartial(fd, (char *) &fileh, sizeof(fileh)) != sizeof(fileh))
+	    || (ShortToHost(fileh.f_magic) != MIPSELMAGIC)
+	    || (fileh.f_symptr == 0)) {
+	Close(fd);
+	return;
+    }
+    Lseek(fd, WordToHost(fileh.f_symptr), 0);
+    if ((ReadPartial(fd, header, SymHeaderSize) != SymHeaderSize)
+	    || (ShortToHost(*(unsigned short *) header) != SymMagic)) {
+	Close(fd);
+	return;
+    }
+    numExternals = WordAt(header, SymIextMax);
+    stringSize = WordAt(header, SymIssExtMax);
+
+    symbolNames = new char[stringSize + 1];
+    symbolNames[stringSize] = '\0';
+    Lseek(fd, WordAt(header, SymCbSsExtOffset), 0);
+    if (ReadPartial(fd, symbolNames, stringSize) != stringSize)
+	numExternals = 0;
+    externals = new char[numExternals * ExtSize];
+    Lseek(fd, WordAt(header, SymCbExtOffset), 0);
+    if (ReadPartial(fd, externals, numExternals * ExtSize)
+	    != numExternals * ExtSize)
+	numExternals = 0;
+    Close(fd);
+
+    symbols = new ProfileSymbol[numExternals + 1];
+    for (i = 0; i < numExternals; i++) {
+	char *ext = externals + i * ExtSize;
+
+	bits = WordAt(ext, ExtBits);
+	if (((bits >> 6) & 0x1f) != ScText)
+	    continue;
+	if (((bits & 0x3f) != StProc) && ((bits & 0x3f) != StStaticProc)
+		&& ((bits & 0x3f) != StGlobal) && ((bits & 0x3f) != StLabel))
+	    continue;
+	if ((WordAt(ext, ExtIss) < 0) || (WordAt(ext, ExtIss) >= stringSize))
+	    continue;
+	symbols[numSymbols].vaddr = WordAt(ext, ExtValue);
+	symbols[numSymbols].name = symbolNames + WordAt(ext, ExtIss);
+	numSymbols++;
+    }
+    delete [] externals;
+    for (i = 1; i < numSymbols; i++) {	// sort them by address
+	ProfileSymbol symbol = symbols[i];
+	int j;
+
+	for (j = i; (j > 0) && (symbols[j - 1].vaddr > symbol.vaddr); j--)
+	    symbols[j] = symbols[j - 1];
+	symbols[j] = symbol;
+    }
+    DEBUG('a', "Read %d symbols for profiling %s\n", numSymbols, program);
+}
+
+//----------------------------------------------------------------------
+// Profile::Symbolize
+// 	Describe "vaddr" as an offset into the procedure containing it,
+//	or as a bare address if we don't know the procedure.
+//
+//	"buffer" -- where to put the description; returned
+//----------------------------------------------------------------------
+
+char *
+Profile::Symbolize(int vaddr, char *buffer)
+{
+    int low = 0, high = numSymbols - 1, mid;
+
+    if ((numSymbols == 0) || (vaddr < symbols[0].vaddr)) {
+	sprintf(buffer, "0x%x", vaddr);
+	return buffer;
+    }
+    while (low < high) {		// last symbol at or below vaddr
+	mid = (low + high + 1) / 2;
+	if (symbols[mid].vaddr <= vaddr)
+	    low = mid;
+	else
+	    high = mid - 1;
+    }
+    if (vaddr == symbols[low].vaddr)
+	sprintf(buffer, "%.60s", symbols[low].name);
+    else
+	sprintf(buffer, "%.60s+0x%x", symbols[low].name,
+		vaddr - symbols[low].vaddr);
+    return buffer;
+}
+
+//----------------------------------------------------------------------
+// Profile::Dump
+// 	Write out the profile collected so far, as a binary histogram
+//	and a text report (see the top of this file).
+//
+//	"pid" -- the process id, to tell apart dumps of one program
+//----------------------------------------------------------------------
+
+void
+Profile::Dump(int pid)
+{
+    char *name = new char[strlen(program) + 20];
+    char line[200], where[80];
+    unsigned int instrs = 0, loads = 0, stores = 0, branches = 0, jumps = 0;
+    unsigned int *perSymbol;
+    int *records;
+    ProfileBlock *blocks;
+    int numRecords = 0, numBlocks = 0, fd, i, j, op;
+    bool open = FALSE;
+
+    records = new int[4 + 4 * numSlots];
+    blocks = new ProfileBlock[numSlots];
+    for (i = 0; i < numSlots; i++) {
+	if (counts[i] == 0) {
+	    open = FALSE;
+	    continue;
+	}
+	op = ops[i];
+	instrs += counts[i];
+	if ((op >= OP_LB) && (op <= OP_LWR) && (op != OP_LUI))
+	    loads += counts[i];
+	else if ((op == OP_SB) || (op == OP_SH) || ((op >= OP_SW)
+						   && (op <= OP_SWR)))
+	    stores += counts[i];
+	else if (IsBranch(op)) {
+	    branches += counts[i];
+	    jumps += taken[i];
+	}
+	records[4 + 4 * numRecords] = i * 4;
+	records[5 + 4 * numRecords] = counts[i];
+	records[6 + 4 * numRecords] = IsBranch(op) ? taken[i] : 0;
+	records[7 + 4 * numRecords] = op;
+	numRecords++;
+
+	if (!open || (counts[i] != blocks[numBlocks - 1].runs)) {
+	    blocks[numBlocks].first = i;
+	    blocks[numBlocks].runs = counts[i];
+	    blocks[numBlocks].instrs = 0;
+	    numBlocks++;
+	    open = TRUE;
+	}
+	blocks[numBlocks - 1].last = i;
+	blocks[numBlocks - 1].instrs += counts[i];
+	if (IsTrap(op) || ((i > blocks[numBlocks - 1].first)
+			   && IsBranch(ops[i - 1])))
+	    open = FALSE;		// that was a syscall or delay slot
+    }
+
+    sprintf(name, "%s.%d.prof", program, pid);
+    fd = OpenForWrite(name);
+    records[0] = ProfileMagic;
+    records[1] = numSlots;
+    records[2] = pid;
+    records[3] = numRecords;
+    WriteFile(fd, (char *) records, (4 + 4 * numRecords) * sizeof(int));
+    Close(fd);
+    delete [] records;
+
+    sprintf(name, "%s.%d.txt", program, pid);
+    fd = OpenForWrite(name);
+    sprintf(line, "Profile of %.100s, process %d\n", program, pid);
+    WriteLine(fd, line);
+    sprintf(line, "Instructions %u, loads %u, stores %u, branches %u "
+	    "(%u taken)\n\n", instrs, loads, stores, branches, jumps);
+    WriteLine(fd, line);
+
+    for (i = 0; (i < numBlocks) && (i < ProfileHotBlocks); i++) {
+	ProfileBlock hottest;		// move the next hottest to the front
+
+	for (j = i + 1; j < numBlocks; j++)
+	    if (blocks[j].instrs > blocks[i].instrs) {
+		hottest = blocks[i];
+		blocks[i] = blocks[j];
+		blocks[j] = hottest;
+	    }
+    }
+    WriteLine(fd, "Hottest basic blocks:\n");
+    sprintf(line, "%10s %10s %10s %10s %6s  %s\n", "start", "end", "runs",
+	    "instrs", "%", "where");
+    WriteLine(fd, line);
+    for (i = 0; (i < numBlocks) && (i < ProfileHotBlocks); i++) {
+	sprintf(line, "%#10x %#10x %10u %10u %6.2f  %s\n",
+		blocks[i].first * 4, blocks[i].last * 4, blocks[i].runs,
+		blocks[i].instrs, 100.0 * blocks[i].instrs / instrs,
+		Symbolize(blocks[i].first * 4, where));
+	WriteLine(fd, line);
+    }
+
+    if (numSymbols > 0) {		// charge each block to its procedure
+	perSymbol = new unsigned int[numSymbols];
+	for (j = 0; j < numSymbols; j++)
+	    perSymbol[j] = 0;
+	for (i = 0; i < numBlocks; i++)
+	    for (j = numSymbols - 1; j >= 0; j--)
+		if (symbols[j].vaddr <= blocks[i].first * 4) {
+		    perSymbol[j] += blocks[i].instrs;
+		    break;
+		}
+	WriteLine(fd, "\nProcedures:\n");
+	sprintf(line, "%10s %6s  %s\n", "instrs", "%", "procedure");
+	WriteLine(fd, line);
+	for (j = 0; j < numSymbols; j++)
+	    if (perSymbol[j] > 0) {
+		sprintf(line, "%10u %6.2f  %.60s\n", perSymbol[j],
+			100.0 * perSymbol[j] / instrs, symbols[j].name);
+		WriteLine(fd, line);
+	    }
+	delete [] perSymbol;
+    }
+    Close(fd);
+    delete [] blocks;
+    delete [] name;
+}
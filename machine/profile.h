@@ -0,0 +1,80 @@
+// profile.h
+//	Data structures for profiling the execution of a user program.
+//
+//	A profile is a histogram over the program's address space: how
+//	many times the instruction at each PC was executed, and for
+//	branches how many times they were taken.  The simulator counts
+//	into the profile installed in "machine->profile"; the kernel
+//	installs the profile of the running address space, like its
+//	page table, and dumps it when the program exits or halts.
+//
+//	Counting costs almost nothing per instruction, so unlike
+//	single-stepping in Machine::Debugger, the program runs at full
+//	speed (on the reference interpreter) while it is profiled.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "copyright.h"
+#include "utility.h"
+
+#define ProfileMagic	0x50524f46	// "PROF", first word of a dump
+#define ProfileHotBlocks 20		// basic blocks listed in a report
+
+// One procedure from the program's COFF symbol table, for turning
+// addresses back into names.
+
+class ProfileSymbol {
+  public:
+    int vaddr;			// first instruction of the procedure
+    char *name;
+};
+
+// The following class defines the profile of one user program.
+
+class Profile {
+  public:
+    Profile(char *executable, int size); // Start an empty profile of
+				// "executable", whose address space is
+				// "size" bytes; read its symbols from
+				// "executable".coff, if there is one
+    ~Profile();
+
+    void Count(int pc, int opCode, int nextPC) {
+				// Count one completed instruction;
+				// "nextPC" is NextPCReg after it ran
+	unsigned int slot = (unsigned int) pc / 4;
+
+	if (slot < (unsigned int) numSlots) {
+	    counts[slot]++;
+	    ops[slot] = opCode;
+	    if (nextPC != pc + 8)	// a taken branch or jump, or
+		taken[slot]++;		// (ignored) its delay slot
+	}
+    }
+
+    void Dump(int pid);		// Write "program"."pid".prof, the raw
+				// histogram, and "program"."pid".txt, a
+				// report of the hottest code
+
+    char *program;		// name of the executable
+
+  private:
+    void LoadSymbols();		// read the COFF symbol table
+    char *Symbolize(int vaddr, char *buffer);
+				// "vaddr" as procedure+offset
+
+    int numSlots;		// one per word of the address space
+    unsigned int *counts;	// executions of the instruction at each PC
+    unsigned int *taken;	// how often control didn't fall through
+    char *ops;			// opCode of each instruction seen
+    ProfileSymbol *symbols;	// procedures, sorted by address
+    int numSymbols;
+    char *symbolNames;		// the COFF string space they point into
+};
+
+#endif // PROFILE_H
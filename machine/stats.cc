@@ -19,9 +19,14 @@
 Statistics::Statistics()
 {
     totalTicks = idleTicks = systemTicks = userTicks = 0;
+    numUserInstrs = tlbMissTicks = pageFaultTicks = 0;
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numPagesFaultedAround = 0;
+    numTLBHits = numTLBMisses = numPageSwapOut = numPageCopies = 0;
+    numPageEvictions = numPageWritebacks = 0;
+    replacePolicy = NULL;
 }
 
 //----------------------------------------------------------------------
@@ -35,11 +40,20 @@ Statistics::Print()
 {
     printf("Ticks: total %d, idle %d, system %d, user %d\n", totalTicks, 
 	idleTicks, systemTicks, userTicks);
+    printf("User code: instructions %d, TLB misses %d\n", numUserInstrs,
+	numTLBMisses);
+    printf("Stalls: TLB misses %d ticks, page faults %d ticks\n",
+	tlbMissTicks, pageFaultTicks);
     printf("Disk I/O: reads %d, writes %d\n", numDiskReads, numDiskWrites);
     printf("Console I/O: reads %d, writes %d\n", numConsoleCharsRead,
            numConsoleCharsWritten);
-    printf("Paging: faults %d\n", numPageFaults);
+    printf("Paging: faults %d, pages faulted around %d\n", numPageFaults,
+	   numPagesFaultedAround);
     printf("Paging: swap out pages %d\n", numPageSwapOut);
+    printf("Paging: pages copied on write %d\n", numPageCopies);
+    if (replacePolicy != NULL)
+	printf("Paging: %s replacement, evictions %d, written back %d\n",
+	       replacePolicy, numPageEvictions, numPageWritebacks);
     printf("Network I/O: packets received %d, sent %d\n", numPacketsRecvd, 
 	numPacketsSent);
 }
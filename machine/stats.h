@@ -25,17 +25,29 @@ class Statistics {
     int idleTicks;       	// Time spent idle (no threads to run)
     int systemTicks;	 	// Time spent executing system code
     int userTicks;       	// Time spent executing user code
-				// (this is also equal to # of
-				// user instructions executed)
+				// (the cycles of the instructions run,
+				// and of their stalls, per the cost
+				// model; by default, one per instruction)
+    int numUserInstrs;		// number of user instructions executed
+    int tlbMissTicks;		// part of userTicks stalled on TLB misses
+    int pageFaultTicks;		// and on page faults
 
     int numDiskReads;		// number of disk read requests
     int numDiskWrites;		// number of disk write requests
     int numConsoleCharsRead;	// number of characters read from the keyboard
     int numConsoleCharsWritten; // number of characters written to the display
     int numPageFaults;		// number of virtual memory page faults
+    int numPagesFaultedAround;	// pages read in along with the one
+				// faulted on
     int numTLBHits;
     int numTLBMisses;
     int numPageSwapOut;
+    int numPageCopies;		// pages copied on write after a Fork
+    int numPageEvictions;	// frames taken from their owners
+    int numPageWritebacks;	// of those, pages written to swap or to
+				// their mapped file first
+    char *replacePolicy;	// name of the policy choosing the frames,
+				// if there is paging
     int numPacketsSent;   // number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
 
@@ -52,7 +64,7 @@ class Statistics {
 // in the kernel measured by the number of calls to enable interrupts,
 // these time constants are none too exact.
 
-#define UserTick 	1	// advance for each user-level instruction 
+#define UserTick 	1	// advance for each cycle of user code
 #define SystemTick 	10 	// advance each time interrupts are enabled
 #define RotationTime 	500 	// time disk takes to rotate one sector
 #define SeekTime 	500    	// time disk takes to seek past one track
@@ -35,6 +35,7 @@ extern "C" {
 #include <sys/file.h>
 #include <sys/un.h>
 #include <sys/mman.h>
+#include <pthread.h>
 #ifdef HOST_i386
 #include <unistd.h>
 #include <sys/time.h>
@@ -502,3 +503,100 @@ DeallocBoundedArray(char *ptr, int size)
     mprotect(ptr + size, pgSize, PROT_READ | PROT_WRITE | PROT_EXEC);
     delete [] (ptr - pgSize);
 }
+
+//----------------------------------------------------------------------
+// AllocExecutableArray
+// 	Return an array the host CPU is allowed to execute, for code
+//	generated at run time.  Returns NULL if the host refuses.
+//
+//	"size" -- amount of space needed (in bytes)
+//----------------------------------------------------------------------
+
+char *
+AllocExecutableArray(int size)
+{
+    char *ptr = (char *) mmap(NULL, size, PROT_READ | PROT_WRITE | PROT_EXEC,
+			      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (ptr == (char *) MAP_FAILED)
+	return NULL;
+    return ptr;
+}
+
+//----------------------------------------------------------------------
+// RunInParallel
+// 	Call func(0), func(1), ... func(count - 1) at the same time, on 
+//	different host threads, and return when they have all finished.
+//	The caller makes the first call itself; the others go to a pool
+//	of worker threads, started as they are first needed and kept
+//	until Nachos exits.
+//
+//	Nothing else in Nachos is thread-safe: "func" must only touch
+//	state that no other call is using.
+//
+//	"count" -- how many calls to make
+//	"func" -- the routine to call, with the number of the call
+//----------------------------------------------------------------------
+
+#define MaxWorkers	63
+
+static pthread_mutex_t workLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t workPosted = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t workDone = PTHREAD_COND_INITIALIZER;
+static VoidFunctionPtr workFunc;
+static int workNext, workCount;		// calls handed out, and to make
+static int workPending;			// calls not yet finished
+static int numWorkers;
+
+static void
+DoWork()				// called and returns with workLock held
+{
+    int which = workNext++;
+
+    pthread_mutex_unlock(&workLock);
+    (*workFunc)(which);
+    pthread_mutex_lock(&workLock);
+    if (--workPending == 0)
+	pthread_cond_signal(&workDone);
+}
+
+static void *
+Worker(void *dummy)
+{
+    pthread_mutex_lock(&workLock);
+    for (;;) {
+	while (workNext >= workCount)
+	    pthread_cond_wait(&workPosted, &workLock);
+	DoWork();
+    }
+    return NULL;
+}
+
+void
+RunInParallel(int count, VoidFunctionPtr func)
+{
+    pthread_t worker;
+
+    pthread_mutex_lock(&workLock);
+    while ((numWorkers < count - 1) && (numWorkers < MaxWorkers)
+	   && (pthread_create(&worker, NULL, Worker, NULL) == 0)) {
+	pthread_detach(worker);
+	numWorkers++;
+    }
+    workFunc = func;
+    workNext = 1;
+    workCount = count;
+    workPending = count - 1;
+    pthread_cond_broadcast(&workPosted);
+    pthread_mutex_unlock(&workLock);
+
+    (*func)(0);
+
+    pthread_mutex_lock(&workLock);
+    while (workNext < workCount)	// more calls than workers
+	DoWork();
+    while (workPending > 0)
+	pthread_cond_wait(&workDone, &workLock);
+    workNext = workCount = 0;
+    pthread_mutex_unlock(&workLock);
+}
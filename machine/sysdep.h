@@ -55,6 +55,12 @@ extern int Random();
 extern char *AllocBoundedArray(int size);
 extern void DeallocBoundedArray(char *p, int size);
 
+// Allocate memory that generated code can be executed from
+extern char *AllocExecutableArray(int size);
+
+// Call func(0) .. func(count - 1) on host threads, and wait for them all
+extern void RunInParallel(int count, VoidFunctionPtr func);
+
 // Other C library routines that are used by Nachos.
 // These are assumed to be portable, so we don't include a wrapper.
 extern "C" {
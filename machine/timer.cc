@@ -86,7 +86,7 @@ int
 Timer::TimeOfNextInterrupt() 
 {
     if (randomize)
-	return 1 + (Random() % (TimerTicks * 2));
+	return 1 + (traceLog->Random() % (TimerTicks * 2));
     else
 	return TimerTicks; 
 }
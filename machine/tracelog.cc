@@ -0,0 +1,383 @@
+// tracelog.cc
+//	Routines to record and replay the nondeterministic inputs of a
+//	simulation.  See tracelog.h for what is logged.
+//
+//	The log is a header -- TraceMagic and a flags word -- followed by
+//	records in the order they happened.  Numbers are stored 7 bits per
+//	byte, low bits first, with the top bit set on all but the last
+//	byte; signed numbers are first folded so that small negative
+//	values stay short.  Times are stored as the difference from the
+//	previous record, so a record usually takes three or four bytes.
+//
+//	While replaying we keep the next record parsed, and each input
+//	routine checks it against the kind of input and the current tick.
+//	Polls for input just return FALSE until the tick the input was
+//	recorded at; the other inputs must be next in the log, or the
+//	replay has diverged and we stop.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "tracelog.h"
+#include "system.h"
+#include <string.h>
+
+// Names of the kinds of records, for reporting a divergence.
+static char *traceEventNames[] = { "random number", "interrupt",
+				   "console input", "network input" };
+
+//----------------------------------------------------------------------
+// TraceLog::TraceLog
+// 	Open the log.  When replaying, read its header, which says
+//	whether the recording used -rs.
+//
+//	"how" -- whether to record, replay or do neither
+//	"fileName" -- the log file (unused with TraceOff)
+//	"withRandomYield" -- whether this run uses -rs, to be recorded
+//----------------------------------------------------------------------
+
+TraceLog::TraceLog(TraceMode how, char *fileName, bool withRandomYield)
+{
+    mode = how;
+    randomYield = withRandomYield;
+    lastTime = 0;
+    bufferUsed = bufferSize = 0;
+    haveRecord = FALSE;
+    recordData = NULL;
+    recordDataSize = 0;
+    fd = -1;
+    if (mode == TraceRecord) {
+	fd = OpenForWrite(fileName);
+	PutNumber(TraceMagic);
+	PutNumber(withRandomYield ? 1 : 0);
+    } else if (mode == TraceReplay) {
+	fd = OpenForReadWrite(fileName, TRUE);
+	if (GetNumber() != TraceMagic) {
+	    printf("%s is not a trace log\n", fileName);
+	    ASSERT(FALSE);
+	}
+	randomYield = (GetNumber() & 1) ? TRUE : FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// TraceLog::~TraceLog
+// 	Write out anything still buffered, and close the log.
+//----------------------------------------------------------------------
+
+TraceLog::~TraceLog()
+{
+    if (mode == TraceRecord)
+	Flush();
+    if (fd >= 0)
+	Close(fd);
+    delete [] recordData;
+}
+
+//----------------------------------------------------------------------
+// TraceLog::Random
+// 	Return a pseudo-random number, as sysdep's Random does.
+//----------------------------------------------------------------------
+
+int
+TraceLog::Random()
+{
+    int value;
+
+    if (mode == TraceReplay) {
+	Expect(TraceRandom);
+	return recordValue;
+    }
+    value = ::Random();
+    if (mode == TraceRecord)
+	Put(TraceRandom, value);
+    return value;
+}
+
+//----------------------------------------------------------------------
+// TraceLog::PollFile, TraceLog::Read, TraceLog::ReadPartial
+// 	Check for and read console input, as the routines of the same
+//	name in sysdep.cc do.  Input is only logged once it is read.
+//	ReadPartial, for system calls reading the console directly, logs
+//	how many bytes it got (0 or less at the end of input) with them.
+//----------------------------------------------------------------------
+
+bool
+TraceLog::PollFile(int consoleFd)
+{
+    if (mode == TraceReplay)
+	return Next(TraceConsoleInput);
+    return ::PollFile(consoleFd);
+}
+
+void
+TraceLog::Read(int consoleFd, char *buf, int nBytes)
+{
+    if (mode == TraceReplay) {
+	Expect(TraceConsoleInput);
+	ASSERT(recordValue == nBytes);
+	memcpy(buf, recordData, nBytes);
+	return;
+    }
+    ::Read(consoleFd, buf, nBytes);
+    if (mode == TraceRecord)
+	PutBytes(TraceConsoleInput, buf, nBytes);
+}
+
+int
+TraceLog::ReadPartial(int consoleFd, char *buf, int nBytes)
+{
+    int n;
+
+    if (mode == TraceReplay) {
+	Expect(TraceConsoleInput);
+	ASSERT(recordValue <= nBytes);
+	if (recordValue > 0)
+	    memcpy(buf, recordData, recordValue);
+	return recordValue;
+    }
+    n = ::ReadPartial(consoleFd, buf, nBytes);
+    if (mode == TraceRecord)
+	PutBytes(TraceConsoleInput, buf, n);
+    return n;
+}
+
+//----------------------------------------------------------------------
+// TraceLog::PollSocket, TraceLog::ReadFromSocket
+// 	Check for and read packets from the network, as the routines of
+//	the same name in sysdep.cc do.
+//----------------------------------------------------------------------
+
+bool
+TraceLog::PollSocket(int sockID)
+{
+    if (mode == TraceReplay)
+	return Next(TraceNetworkInput);
+    return ::PollSocket(sockID);
+}
+
+void
+TraceLog::ReadFromSocket(int sockID, char *buf, int packetSize)
+{
+    if (mode == TraceReplay) {
+	Expect(TraceNetworkInput);
+	ASSERT(recordValue == packetSize);
+	memcpy(buf, recordData, packetSize);
+	return;
+    }
+    ::ReadFromSocket(sockID, buf, packetSize);
+    if (mode == TraceRecord)
+	PutBytes(TraceNetworkInput, buf, packetSize);
+}
+
+//----------------------------------------------------------------------
+// TraceLog::SendToSocket
+// 	Send a packet, as sysdep's SendToSocket does -- except when
+//	replaying, since the other machines are only in the log.
+//----------------------------------------------------------------------
+
+void
+TraceLog::SendToSocket(int sockID, char *buf, int packetSize,
+		       char *toName)
+{
+    if (mode != TraceReplay)
+	::SendToSocket(sockID, buf, packetSize, toName);
+}
+
+//----------------------------------------------------------------------
+// TraceLog::Delivered
+// 	Note that an interrupt of "type" is being delivered at the
+//	current tick; when replaying, check that it was in the recording.
+//----------------------------------------------------------------------
+
+void
+TraceLog::Delivered(int type)
+{
+    if (mode == TraceRecord)
+	Put(TraceInterrupt, type);
+    else if (mode == TraceReplay) {
+	Expect(TraceInterrupt);
+	if (recordValue != type)
+	    Diverged(TraceInterrupt);
+    }
+}
+
+//----------------------------------------------------------------------
+// TraceLog::Put, TraceLog::PutBytes
+// 	Append a record of "kind", for the current tick, to the log.
+//
+//	"value" -- the value of the record
+//	"data", "nBytes" -- the bytes of the record
+//----------------------------------------------------------------------
+
+void
+TraceLog::Put(TraceEvent kind, int value)
+{
+    PutByte(kind);
+    PutNumber(stats->totalTicks - lastTime);
+    lastTime = stats->totalTicks;
+    PutNumber(value);
+}
+
+void
+TraceLog::PutBytes(TraceEvent kind, char *data, int nBytes)
+{
+    Put(kind, nBytes);
+    for (int i = 0; i < nBytes; i++)
+	PutByte(data[i]);
+}
+
+//----------------------------------------------------------------------
+// TraceLog::PutNumber, TraceLog::PutByte
+// 	Append a (variable-length) number, or a single byte, to the log.
+//----------------------------------------------------------------------
+
+void
+TraceLog::PutNumber(int value)
+{
+    unsigned int folded = (value << 1) ^ (value >> 31);
+
+    while (folded >= 0x80) {
+	PutByte((folded & 0x7f) | 0x80);
+	folded >>= 7;
+    }
+    PutByte(folded);
+}
+
+void
+TraceLog::PutByte(int byte)
+{
+    if (bufferUsed == TraceBufferSize)
+	Flush();
+    buffer[bufferUsed++] = byte;
+}
+
+//----------------------------------------------------------------------
+// TraceLog::Flush
+// 	Write the buffered part of the log to the file.
+//----------------------------------------------------------------------
+
+void
+TraceLog::Flush()
+{
+    if (bufferUsed > 0)
+	WriteFile(fd, buffer, bufferUsed);
+    bufferUsed = 0;
+}
+
+//----------------------------------------------------------------------
+// TraceLog::Next
+// 	Return TRUE if the next record in the log is an input of "kind"
+//	for the current tick.
+//----------------------------------------------------------------------
+
+bool
+TraceLog::Next(TraceEvent kind)
+{
+    return Parse() && (recordKind == kind)
+	&& (recordTime == stats->totalTicks);
+}
+
+//----------------------------------------------------------------------
+// TraceLog::Expect
+// 	Take the next record from the log, which must be of "kind" and
+//	for the current tick; its contents are left in recordValue and
+//	recordData.
+//----------------------------------------------------------------------
+
+void
+TraceLog::Expect(TraceEvent kind)
+{
+    if (!Next(kind))
+	Diverged(kind);
+    haveRecord = FALSE;
+}
+
+//----------------------------------------------------------------------
+// TraceLog::Diverged
+// 	The run being replayed wanted something other than what comes
+//	next in the log.  Say where, and stop.
+//----------------------------------------------------------------------
+
+void
+TraceLog::Diverged(TraceEvent kind)
+{
+    printf("Replay diverged at tick %d, wanting %s: ", stats->totalTicks,
+	   traceEventNames[kind]);
+    if (haveRecord)
+	printf("the log has %s %d at tick %d\n",
+	       traceEventNames[recordKind], recordValue, recordTime);
+    else
+	printf("the log has ended\n");
+    fflush(stdout);
+    ASSERT(FALSE);
+}
+
+//----------------------------------------------------------------------
+// TraceLog::Parse
+// 	Make sure the next record of the log has been read.  Return
+//	FALSE at the end of the log.
+//----------------------------------------------------------------------
+
+bool
+TraceLog::Parse()
+{
+    int kind;
+
+    if (haveRecord)
+	return TRUE;
+    if ((kind = GetByte()) < 0)
+	return FALSE;
+    ASSERT(kind < NumTraceEvents);
+    recordKind = (TraceEvent) kind;
+    recordTime = lastTime + GetNumber();
+    lastTime = recordTime;
+    recordValue = GetNumber();
+    if ((kind == TraceConsoleInput) || (kind == TraceNetworkInput)) {
+	if (recordValue > recordDataSize) {
+	    delete [] recordData;
+	    recordData = new char[recordValue];
+	    recordDataSize = recordValue;
+	}
+	for (int i = 0; i < recordValue; i++)
+	    recordData[i] = GetByte();
+    }
+    haveRecord = TRUE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// TraceLog::GetNumber, TraceLog::GetByte
+// 	Read a (variable-length) number, or a single byte, from the log.
+//----------------------------------------------------------------------
+
+int
+TraceLog::GetNumber()
+{
+    unsigned int folded = 0;
+    int byte, shift = 0;
+
+    do {
+	byte = GetByte();
+	ASSERT(byte >= 0);		// log cut off in mid-record
+	folded |= (byte & 0x7f) << shift;
+	shift += 7;
+    } while (byte & 0x80);
+    return (folded >> 1) ^ -(int)(folded & 1);
+}
+
+int
+TraceLog::GetByte()
+{
+    if (bufferUsed == bufferSize) {
+	bufferSize = ::ReadPartial(fd, buffer, TraceBufferSize);
+	bufferUsed = 0;
+	if (bufferSize <= 0) {
+	    bufferSize = 0;
+	    return -1;
+	}
+    }
+    return (unsigned char) buffer[bufferUsed++];
+}
@@ -0,0 +1,106 @@
+// tracelog.h
+//	Data structures to record the nondeterministic inputs of a
+//	simulation, and to replay them.
+//
+//	Given the same inputs, Nachos is deterministic: every tick, every
+//	interrupt and every context switch happens at the same point.  The
+//	inputs are the few places where the simulation looks outside
+//	itself -- Random() (the timer under -rs, lost network packets),
+//	characters arriving on the console and packets arriving on the
+//	network.  With "-rec <file>" each of these is logged, together
+//	with the tick it happened at; with "-replay <file>" they are taken
+//	from the log instead, so the run is repeated exactly.  The time
+//	and type of every interrupt delivered is logged as well, so that
+//	a replay stops at the first tick where it diverges from the
+//	recording (for instance because the kernel was changed).
+//
+//	Other arguments, such as the program to run, must be the same
+//	for the replay as for the recording.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef TRACELOG_H
+#define TRACELOG_H
+
+#include "copyright.h"
+#include "utility.h"
+
+#define TraceMagic	0x4e545243	// "NTRC", first word of a log
+#define TraceBufferSize	4096		// bytes buffered on the host side
+
+enum TraceMode { TraceOff, TraceRecord, TraceReplay };
+
+// The kinds of records in a log.  Each record is the kind (one byte),
+// the ticks since the previous record, and then either a value or
+// a count of bytes followed by the bytes; numbers are variable-length.
+
+enum TraceEvent { TraceRandom,		// a value returned by Random()
+		  TraceInterrupt,	// an interrupt of the given type
+					// was delivered
+		  TraceConsoleInput,	// bytes read from the console
+		  TraceNetworkInput,	// a packet read from the network
+		  NumTraceEvents
+};
+
+// The following class defines the log.  The kernel always has one:
+// with TraceOff, its routines just call the matching routine in
+// sysdep.cc.
+
+class TraceLog {
+  public:
+    TraceLog(TraceMode how, char *fileName, bool withRandomYield);
+				// Start recording to, or replaying from,
+				// "fileName"; "withRandomYield" (-rs) is
+				// saved in the log
+    ~TraceLog();		// Finish writing the log
+
+    bool randomYield;		// when replaying, whether the recording
+				// was made with -rs
+    bool Replaying() { return mode == TraceReplay; }
+
+// Inputs to the simulation, logged or replayed
+    int Random();
+    bool PollFile(int consoleFd);
+    void Read(int consoleFd, char *buf, int nBytes);
+    int ReadPartial(int consoleFd, char *buf, int nBytes);
+    bool PollSocket(int sockID);
+    void ReadFromSocket(int sockID, char *buf, int packetSize);
+    void SendToSocket(int sockID, char *buf, int packetSize,
+		      char *toName);
+
+    void Delivered(int type);	// an interrupt of "type" is being
+				// delivered now
+
+  private:
+    void Put(TraceEvent kind, int value);
+    void PutBytes(TraceEvent kind, char *data, int nBytes);
+    void PutNumber(int value);
+    void PutByte(int byte);
+    void Flush();		// write out the buffered records
+
+    bool Next(TraceEvent kind);	// TRUE if the next record is of "kind"
+				// and for the current tick
+    void Expect(TraceEvent kind);	// the next record had better be
+    void Diverged(TraceEvent kind);	// report that it isn't
+    bool Parse();		// read the next record, if any
+    int GetNumber();
+    int GetByte();		// -1 at the end of the log
+
+    TraceMode mode;
+    int fd;			// the log file
+    int lastTime;		// tick of the last record
+    char buffer[TraceBufferSize];
+    int bufferUsed;		// bytes of it written, or read
+    int bufferSize;		// bytes of it valid, when replaying
+
+    bool haveRecord;		// the next record, when replaying
+    TraceEvent recordKind;
+    int recordTime;
+    int recordValue;		// value, or # bytes
+    char *recordData;
+    int recordDataSize;		// bytes allocated for recordData
+};
+
+#endif // TRACELOG_H
@@ -73,44 +73,306 @@ WordToMachine(unsigned int word) { return WordToHost(word); }
 unsigned short
 ShortToMachine(unsigned short shortword) { return ShortToHost(shortword); }
 
-void SwapoutPage(int page){
+// 页框里的页面(共享时为其主人的)的页表项
+TranslationEntry *FrameEntry(int page){
+    Frame *frame = &machine->frames[page];
+    return frame->owner->pageTable + frame->vpn;
+}
+
+// 把页框写到一个新的交换页 记在页框主人的页表项上 返回交换页号
+int SwapoutPage(int page){
     DEBUG('a', "Save page %d to swap space~~\n", page);
     stats->numPageSwapOut++;
     int store = machine->swapMap->Find();
-    machine->page2Entry[page]->dirty = TRUE;
-    machine->page2Entry[page]->swapPage = store;
     ASSERT(store >= 0);
+    machine->swapRefs[store] = 0;
+    ShareSwap(FrameEntry(page), store);
     machine->swapSpace->WriteAt(machine->mainMemory + page * PageSize, PageSize, store * PageSize);
+    return store;
+}
+
+// 页表项也指向交换页store (fork后共享的页面 只写一份)
+// 交换页写好之后不再改动 所以共享它的页面各自换入即可
+void ShareSwap(TranslationEntry *entry, int store){
+    entry->dirty = TRUE;
+    entry->swapPage = store;
+    machine->swapRefs[store]++;
+}
+
+// 页表项不再指向它的交换页 没人指向了就释放
+void ReleaseSwap(TranslationEntry *entry){
+    int store = entry->swapPage;
+    ASSERT(machine->swapRefs[store] > 0);
+    if(--machine->swapRefs[store] == 0)
+        machine->swapMap->Clear(store);
+    entry->swapPage = -1;
+}
+
+// 映射文件的页面写回文件本身 文件末尾之外的部分不写
+void WritebackPage(TranslationEntry *entry){
+    int page = entry->physicalPage;
+    int size = min(PageSize, entry->mappedFile->Length() - entry->fileAddr);
+    DEBUG('a', "Write page %d back to its mapped file\n", page);
+    if(size > 0)
+        entry->mappedFile->WriteAt(machine->mainMemory + page * PageSize, size, entry->fileAddr);
+    entry->dirty = FALSE;
 }
  
+//----------------------------------------------------------------------
+// 页框的主人与共享者
+// fork出的页表一一对应 共享者一定在同一个虚页上
+// 所以页框表只记一个主人和虚页号 其余共享者挂在sharers上
+//----------------------------------------------------------------------
+
+// fork时 页框也归子进程space所有
+void ShareFrame(int page, AddrSpace *space){
+    Frame *frame = &machine->frames[page];
+    if(frame->sharers == NULL)
+        frame->sharers = new List;
+    frame->sharers->Append((void *)space);
+    frame->refCount++;
+}
+
+// space不再占用页框 主人走了由下一个共享者接手
+// 返回TRUE表示已经没人用它了
+static bool Disown(int page, AddrSpace *space){
+    Frame *frame = &machine->frames[page];
+    ASSERT(frame->refCount > 0);
+    if(--frame->refCount == 0){
+        frame->owner = NULL;
+        return TRUE;
+    }
+    if(frame->owner == space)
+        frame->owner = (AddrSpace *)frame->sharers->Remove();
+    else
+        frame->sharers->Remove((void *)space);
+    if(frame->refCount == 1){
+        delete frame->sharers;
+        frame->sharers = NULL;
+    }
+    return FALSE;
+}
+
+// 释放space的虚页vpn对其页框的占用 没人用了就放回空闲链表
+void ReleaseFrame(AddrSpace *space, int vpn){
+    int page = space->pageTable[vpn].physicalPage;
+    ASSERT(machine->frames[page].vpn == vpn);
+    if(Disown(page, space)){
+        machine->frames[page].nextFree = machine->freeFrames;
+        machine->freeFrames = page;
+    }
+}
+
+//----------------------------------------------------------------------
+// 钉住页框的名额
+// I/O期间钉住的页框不会被换出 钉住之前都要先在这里占名额
+// 加起来至多NumPhysPages-1个
+// 总留一个页框让GetPage换出 不会因为全都钉住了而无页可换
+//----------------------------------------------------------------------
+
+int numPinned;
+static List *pinWaiters;            // 等名额的线程
+
+// 占n个名额 不够返回FALSE
+bool ReservePins(int n){
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    bool ok = numPinned + n <= NumPhysPages - 1;
+    if(ok)
+        numPinned += n;
+    (void) interrupt->SetLevel(oldLevel);
+    return ok;
+}
+
+// 等到占上n个名额为止 调用时不能已经占着名额 否则可能互相等
+// 所以钉着页框时不能缺页或写时复制 (它们会在这里等)
+void WaitForPins(int n){
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    ASSERT(n <= NumPhysPages - 1);
+    while(!ReservePins(n)){
+        if(pinWaiters == NULL)
+            pinWaiters = new List;
+        pinWaiters->Append((void *)currentThread);
+        currentThread->Sleep();
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+void ReleasePins(int n){
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    Thread *thread;
+    numPinned -= n;
+    ASSERT(numPinned >= 0);
+    while(pinWaiters != NULL && (thread = (Thread *)pinWaiters->Remove()) != NULL)
+        scheduler->ReadyToRun(thread);
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// 页面置换策略 (-pr)
+// 都从同一个指针scar开始转 跳过钉住的页框
+// 只看页框主人的use/dirty位
+// 清掉use位后 软TLB缓存的翻译不会再把它置上 所以选完要FlushSoftTLB
+//----------------------------------------------------------------------
+
+char *replacePolicyNames[] = { "round robin", "clock", "second chance",
+                               "WSClock", "aging" };
+
+// 换出这个页面要先写回吗
+static bool NeedsWriteback(TranslationEntry *entry){
+    if(entry->mappedFile != NULL)
+        return entry->dirty;
+    return entry->dirty || entry->fileAddr < 0;
+}
+
+// 第i个候选页框 从指针处数起
+static int Candidate(int i){
+    return (scar + i) % NumPhysPages;
+}
+
+// 选中page 指针停在它后面
+static int Victim(int page){
+    scar = page + 1;
+    return page;
+}
+
+static int ChooseVictim(){
+    Frame *frames = machine->frames;
+    int i, page, pass, best, oldDirty;
+    TranslationEntry *entry;
+
+    switch(machine->replacePolicy){
+      case ClockPolicy:
+        // 用过的清掉use位 再给一次机会 转两圈总能找到
+        for(i = 0; i < 2 * NumPhysPages; i++){
+            page = Candidate(i);
+            if(frames[page].pinCount > 0)
+                continue;
+            entry = FrameEntry(page);
+            if(!entry->use)
+                return Victim(page);
+            entry->use = FALSE;
+        }
+        break;
+      case SecondChance:
+        // 依次找 没用过的干净页 / 没用过的脏页(顺带清use位) 再来一遍
+        for(pass = 0; pass < 4; pass++)
+            for(i = 0; i < NumPhysPages; i++){
+                page = Candidate(i);
+                if(frames[page].pinCount > 0)
+                    continue;
+                entry = FrameEntry(page);
+                if(!entry->use && NeedsWriteback(entry) == (pass % 2 == 1))
+                    return Victim(page);
+                if(pass % 2 == 1)
+                    entry->use = FALSE;
+            }
+        break;
+      case WSClockPolicy:
+        // 用过的记下时间 清use位; 出了工作集的干净页直接选中
+        // 转完一圈没有 就选第一个出了工作集的脏页 再不行选最久没用的
+        oldDirty = best = -1;
+        for(i = 0; i < NumPhysPages; i++){
+            page = Candidate(i);
+            if(frames[page].pinCount > 0)
+                continue;
+            entry = FrameEntry(page);
+            if(entry->use){
+                entry->use = FALSE;
+                frames[page].replaceState = stats->totalTicks;
+            } else if(stats->totalTicks - frames[page].replaceState > WorkingSetTicks){
+                if(!NeedsWriteback(entry))
+                    return Victim(page);
+                if(oldDirty < 0)
+                    oldDirty = page;
+            }
+            if(best < 0 || frames[page].replaceState < frames[best].replaceState)
+                best = page;
+        }
+        if(oldDirty >= 0)
+            return Victim(oldDirty);
+        if(best >= 0)
+            return Victim(best);
+        break;
+      case AgingPolicy:
+        // 每次置换都老化一次: 计数右移 use位移入最高位 选计数最小的
+        best = -1;
+        for(i = 0; i < NumPhysPages; i++){
+            page = Candidate(i);
+            entry = FrameEntry(page);
+            frames[page].replaceState = (frames[page].replaceState >> 1) | (entry->use ? 0x80 : 0);
+            entry->use = FALSE;
+            if(frames[page].pinCount == 0
+               && (best < 0 || frames[page].replaceState < frames[best].replaceState))
+                best = page;
+        }
+        if(best >= 0)
+            return Victim(best);
+        break;
+      default:
+        // 轮转 不看use位
+        for(i = 0; i < NumPhysPages; i++){
+            page = Candidate(i);
+            if(frames[page].pinCount == 0)
+                return Victim(page);
+        }
+        break;
+    }
+    ASSERT(FALSE);                  // 所有页框都被钉住了
+    return -1;
+}
+
 //----------------------------------------------------------------------
 // 获取页面 
 // 优先获取空闲页面
 // 如果没有 就选择一牺牲页面
 // 并整合了将牺牲页面载入磁盘的操作...
 //----------------------------------------------------------------------
-int GetPage(TranslationEntry* PTE, bool lazy = false){
-    int page = machine->memoryMap->Find();
-    int store = -1;
-    if (page == -1){
+int GetPage(AddrSpace *space, int vpn, bool lazy = false){
+    int page = machine->freeFrames;
+    Frame *frame;
+    if (page >= 0)
+        machine->freeFrames = machine->frames[page].nextFree;   // 从空闲链表取下
+    else{
         // 选择一个牺牲页面
         if(lazy) return -1;
-        page = (scar++) % NumPhysPages;
+        page = ChooseVictim();
         DEBUG('a', "Allocate a physpage # %d\n", page);
-        // 牺牲页失效
-        machine->page2Entry[page]->valid = false;
-        if(machine->page2Entry[page]->dirty || machine->page2Entry[page]->fileAddr < 0){
-            // 修改过...! 换入交换空间...
-            SwapoutPage(page);
-            // 将牺牲页相关的TLB也标记失效
-            if(machine->tlb !=NULL)
-                for (int i = 0; i < TLBSize;i++)
-                    if(machine->tlb[i].physicalPage == page)
-                        machine->tlb[i].valid = false;
+        stats->numPageEvictions++;
+        machine->FlushSoftTLB();            // 牺牲页的缓存翻译也作废
+        scheduler->InvalidateTLBs(page);    // 其他处理器的TLB也作废
+        // fork后共享的页框 逐个共享者换出 直到没人再用
+        // 要写入交换空间的 只写第一份 其余共享者指向同一个交换页
+        int store = -1;
+        while(machine->frames[page].refCount > 0){
+            TranslationEntry *victim = FrameEntry(page);
+            bool writeback = NeedsWriteback(victim);
+            // 牺牲页失效
+            victim->valid = false;
+            if(writeback){
+                stats->numPageWritebacks++;
+                if(victim->mappedFile != NULL)
+                    WritebackPage(victim);  // 映射文件的页面不进交换空间 写回文件
+                else if(store < 0)
+                    store = SwapoutPage(page);  // 修改过...! 换入交换空间...
+                else
+                    ShareSwap(victim, store);
+            }
+            Disown(page, machine->frames[page].owner);  // 下一个共享者接手
         }
+        // 将牺牲页相关的TLB也标记失效 (干净页面直接丢弃 也不能留下旧的翻译)
+        if(machine->tlb !=NULL)
+            for (int i = 0; i < TLBSize;i++)
+                if(machine->tlb[i].physicalPage == page)
+                    machine->tlb[i].valid = false;
     }
-    // 这个page一定是分给currentThread的
-    machine->page2Entry[page] = PTE;
+    frame = &machine->frames[page];
+    frame->owner = space;
+    frame->vpn = vpn;
+    frame->refCount = 1;
+    // 页面正要被访问
+    space->pageTable[vpn].use = TRUE;
+    frame->replaceState = (machine->replacePolicy == WSClockPolicy) ? stats->totalTicks : 0;
+    machine->InvalidateFrame(page);     // 新内容即将载入 预译码作废
     return page;
 }
 
@@ -135,28 +397,32 @@ Machine::ReadMem(int addr, int size, int *value)
     int data;
     ExceptionType exception;
     int physicalAddress;
+    char *host = SoftTranslate(addr, size, FALSE);
     
-    DEBUG('a', "Reading VA 0x%x, size %d\n", addr, size);
+    if (host == NULL) {
+	DEBUG('a', "Reading VA 0x%x, size %d\n", addr, size);
     
-    exception = Translate(addr, &physicalAddress, size, FALSE);
-    if (exception != NoException) {
-	machine->RaiseException(exception, addr);
-	return FALSE;
+	exception = Translate(addr, &physicalAddress, size, FALSE);
+	if (exception != NoException) {
+	    RaiseException(exception, addr);
+	    return FALSE;
+	}
+	host = &mainMemory[physicalAddress];
     }
     switch (size) {
       case 1:
-	data = machine->mainMemory[physicalAddress];
+	data = *host;
 	*value = data;
 	break;
 	
       case 2:
         // 基于地址的强制类型转换 取引用 获取特定大小
-	data = *(unsigned short *) &machine->mainMemory[physicalAddress];
+	data = *(unsigned short *) host;
 	*value = ShortToHost(data);
 	break;
 	
       case 4:
-	data = *(unsigned int *) &machine->mainMemory[physicalAddress];
+	data = *(unsigned int *) host;
 	*value = WordToHost(data);
 	break;
 
@@ -185,25 +451,33 @@ Machine::WriteMem(int addr, int size, int value)
 {
     ExceptionType exception;
     int physicalAddress;
+    char *host = SoftTranslate(addr, size, TRUE);
      
-    DEBUG('a', "Writing VA 0x%x, size %d, value 0x%x\n", addr, size, value);
+    if (host == NULL) {
+	DEBUG('a', "Writing VA 0x%x, size %d, value 0x%x\n", addr, size, value);
 
-    exception = Translate(addr, &physicalAddress, size, TRUE);
-    if (exception != NoException) {
-	machine->RaiseException(exception, addr);
-	return FALSE;
+	exception = Translate(addr, &physicalAddress, size, TRUE);
+	if (exception != NoException) {
+	    RaiseException(exception, addr);
+	    return FALSE;
+	}
+	host = &mainMemory[physicalAddress];
+    } else
+	physicalAddress = host - mainMemory;
+    if (decoded[physicalAddress / 4]) {		// overwriting code
+	decoded[physicalAddress / 4] = FALSE;
+	frameGeneration[physicalAddress / PageSize]++;
     }
     switch (size) {
       case 1:
-	machine->mainMemory[physicalAddress] = (unsigned char) (value & 0xff);
+	*host = (unsigned char) (value & 0xff);
 	break;
       case 2:
-	*(unsigned short *) &machine->mainMemory[physicalAddress]
+	*(unsigned short *) host
 		= ShortToMachine((unsigned short) (value & 0xffff));
 	break;
       case 4:
-	*(unsigned int *) &machine->mainMemory[physicalAddress]
-		= WordToMachine((unsigned int) value);
+	*(unsigned int *) host = WordToMachine((unsigned int) value);
 	break;
       default: ASSERT(FALSE);
     }
@@ -211,6 +485,98 @@ Machine::WriteMem(int addr, int size, int value)
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// Machine::SoftTranslate
+// 	Translate "addr" using softTLB, the simulator's cache of recent
+//	successful translations, instead of going through Translate.
+//	Returns a pointer into mainMemory, or NULL on a miss or when the
+//	access is misaligned (Translate must then report the fault).
+//
+//	A hit skips only work that would have had no effect: the page
+//	was translated for this kind of access under the current page
+//	table and TLB, so its use and dirty bits are already set.  The
+//	TLB statistics and LRU stamp are still updated, exactly as a
+//	real lookup would.
+//----------------------------------------------------------------------
+
+char *
+Machine::SoftTranslate(int addr, int size, bool writing)
+{
+    unsigned int vpn = (unsigned) addr / PageSize;
+    SoftTLBEntry *cached = &softTLB[writing][vpn % SoftTLBSize];
+
+    if (cached->vpn != (int) vpn || (addr & (size - 1)))
+	return NULL;
+    if (cached->tlbSlot >= 0)
+	TouchTLB(cached->tlbSlot);
+    return cached->host + (unsigned) addr % PageSize;
+}
+
+//----------------------------------------------------------------------
+// Machine::TouchTLB
+// 	Account for a hit on tlb[slot]: count it, and stamp the entry for
+//	the kernel's LRU replacement.  A detached core keeps both to itself
+//	until the kernel merges them, since other cores run at the same
+//	time.
+//----------------------------------------------------------------------
+
+void
+Machine::TouchTLB(int slot)
+{
+    if (detached) {
+	tlbHits++;
+	tlb[slot].last_used = ++tlbStamp;
+    } else {
+	stats->numTLBHits++;
+	tlb[slot].last_used = ++memTime;
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::ChargeStall
+// 	Charge user code for a TLB miss and/or a page fault on the way to
+//	raising PageFaultException: the cycles the cost model gives them
+//	go on the current batch (see Machine::Run), and are also counted
+//	apart in the statistics.  Only user instructions stall; the
+//	kernel touching user memory, or a detached core, does not.
+//----------------------------------------------------------------------
+
+void
+Machine::ChargeStall(bool tlbMiss, bool pageFault)
+{
+    int cycles = 0;
+
+    if (detached || (interrupt->getStatus() != UserMode))
+	return;
+    if (tlbMiss) {
+	stats->numTLBMisses++;
+	stats->tlbMissTicks += tlbMissCycles * UserTick;
+	cycles += tlbMissCycles;
+    }
+    if (pageFault) {
+	stats->pageFaultTicks += pageFaultCycles * UserTick;
+	cycles += pageFaultCycles;
+    }
+    unchargedCycles += cycles;
+}
+
+//----------------------------------------------------------------------
+// Machine::FlushSoftTLB
+// 	Empty softTLB.  Must be called whenever a translation it may hold
+//	stops being current: on a context switch, when the kernel handles
+//	an exception (page faults and TLB refills happen there), and when
+//	a frame is taken away from its page.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushSoftTLB()
+{
+    for (int i = 0; i < SoftTLBSize; i++) {
+	softTLB[0][i].vpn = -1;
+	softTLB[1][i].vpn = -1;
+    }
+}
+
 //----------------------------------------------------------------------
 // Machine::Translate
 // 	Translate a virtual address into a physical address, using 
@@ -260,20 +626,22 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 	} else if (!pageTable[vpn].valid) {
 	    DEBUG('a', "virtual page # %d too large for page table size %d!\n", 
 			virtAddr, pageTableSize);
+	    ChargeStall(FALSE, TRUE);
 	    return PageFaultException;
 	}
 	entry = &pageTable[vpn];
     } else {
-        for (entry = NULL, i = 0; i < TLBSize; i++)     //这里没有确保vpn不越界
+        for (entry = NULL, i = TLBSet(vpn); i < TLBSet(vpn) + TLBWays; i++)
     	    if (tlb[i].valid && (tlb[i].virtualPage == vpn)) {
 		entry = &tlb[i];			// TLB命中
                 //printf("TLB命中%d!\n", vpn);
-                stats->numTLBHits++;
-                tlb[i].last_used = ++memTime;
+                TouchTLB(i);
                 break;
             }
 	if (entry == NULL) {				// not found
     	    DEBUG('a', "*** no valid TLB entry found for this virtual page!\n");
+	    ChargeStall(TRUE, (pageTable != NULL) && (vpn < pageTableSize)
+						&& !pageTable[vpn].valid);
     	    return PageFaultException;		// really, this is a TLB fault,
 						// the page may be in memory,
 						// but not in the TLB （迫真）
@@ -288,7 +656,7 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 
     // if the pageFrame is too big, there is something really wrong! 
     // An invalid translation was loaded into the page table or TLB. 
-    if (pageFrame >= NumPhysPages) { 
+    if ((int) pageFrame >= NumPhysPages) { 
 	DEBUG('a', "*** frame %d > %d!\n", pageFrame, NumPhysPages);
 	return BusErrorException;
     }
@@ -300,6 +668,12 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     }
     *physAddr = pageFrame * PageSize + offset;
     ASSERT((*physAddr >= 0) && ((*physAddr + size) <= MemorySize));
+    if (!DebugIsEnabled('a')) {		// a cached hit would not be traced
+	SoftTLBEntry *cached = &softTLB[writing][vpn % SoftTLBSize];
+	cached->vpn = vpn;
+	cached->host = &mainMemory[pageFrame * PageSize];
+	cached->tlbSlot = (tlb == NULL) ? -1 : i;
+    }
     DEBUG('a', "phys addr = 0x%x\n", *physAddr);
     return NoException;
 }
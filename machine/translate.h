@@ -21,6 +21,9 @@
 #include "copyright.h"
 #include "utility.h"
 
+class OpenFile;
+class AddrSpace;
+
 // The following class defines an entry in a translation table -- either
 // in a page table or a TLB.  Each entry defines a mapping from one 
 // virtual page to one physical page.
@@ -34,11 +37,13 @@ class TranslationEntry {
     int physicalPage;  	// The page number in real memory (relative to the
 			//  start of "mainMemory"
     int swapPage;   // 在交换空间中的位置
-    int fileAddr;   // 在可执行文件中的位置
+    int fileAddr;   // 在可执行文件(或映射文件)中的位置
+    OpenFile *mappedFile;   // 映射文件 页面从它载入、写回它 NULL为可执行文件/匿名页
     bool valid;     // If this bit is set, the translation is ignored.
                     // (In other words, the entry hasn't been initialized.)
     bool readOnly;	// If this bit is set, the user program is not allowed
 			// to modify the contents of the page.
+    bool copyOnWrite;   // 只读只是因为页框与fork出的进程共享 写时复制一份
     bool use;           // This bit is set by the hardware every time the
 			// page is referenced or modified.
     bool dirty;         // This bit is set by the hardware every time the
@@ -48,6 +53,17 @@ class TranslationEntry {
 
 extern int memTime;
 extern int fifoPtr;
-extern int GetPage(TranslationEntry* PTE, bool lazy = false);
-extern void SwapoutPage(int page);
+extern int scar;		// the next frame GetPage takes from its owner
+extern int GetPage(AddrSpace *space, int vpn, bool lazy = false);
+extern TranslationEntry *FrameEntry(int page);
+extern int SwapoutPage(int page);
+extern void ShareSwap(TranslationEntry *entry, int store);
+extern void ReleaseSwap(TranslationEntry *entry);
+extern void WritebackPage(TranslationEntry *entry);
+extern void ShareFrame(int page, AddrSpace *space);
+extern void ReleaseFrame(AddrSpace *space, int vpn);
+extern int numPinned;		// frames pinned, counting each pin
+extern bool ReservePins(int n);	// room to pin "n" more frames?
+extern void WaitForPins(int n);	// wait until there is
+extern void ReleasePins(int n);
 #endif
@@ -0,0 +1,89 @@
+/* aio.c
+ *	Test the asynchronous I/O system calls: ReadAsync, WriteAsync and
+ *	Reap.
+ *
+ *	Writes a buffer spanning several pages to a file without waiting,
+ *	reaps the completion, reads it back in two requests in flight at
+ *	once, and checks the data.  Requests on a file that isn't open
+ *	must be refused.  Run with
+ *
+ *	  nachos -x aio
+ *
+ *	Every line should start with "ok"; the console write prints
+ *	"written asynchronously" too.
+ */
+
+#include "testlib.h"
+
+#define Size	1000		/* about 8 pages, not page aligned */
+#define Half	(Size / 2)
+
+char out[Size], in[Size];
+AioResult results[4];
+
+int
+Same(char *a, char *b, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+	if (a[i] != b[i])
+	    return 0;
+    return 1;
+}
+
+int
+main()
+{
+    OpenFileId fd;
+    AioId id, first, second;
+    int i, n, got, ok;
+    char *msg = "written asynchronously\n";
+
+    for (i = 0; i < Size; i++)
+	out[i] = 'a' + i % 26;
+    Create("aio.tmp");
+    fd = Open("aio.tmp");
+
+    id = WriteAsync(out, Size, fd, 0);
+    Check("WriteAsync queued", id >= 0);
+    n = Reap(results, 4, 1);
+    Check("Reap returns the write",
+	  n == 1 && results[0].id == id && results[0].result == Size);
+    Check("Reap with nothing in progress returns 0",
+	  Reap(results, 4, 1) == 0);
+
+    first = ReadAsync(in, Half, fd, 0);
+    second = ReadAsync(in + Half, Size - Half, fd, Half);
+    Check("two reads queued", first >= 0 && second >= 0 && first != second);
+    ok = 1;
+    for (got = 0; got < 2; got += n) {
+	n = Reap(results, 4, 1);
+	for (i = 0; i < n; i++)
+	    if (results[i].id == first)
+		ok = ok && results[i].result == Half;
+	    else if (results[i].id == second)
+		ok = ok && results[i].result == Size - Half;
+	    else
+		ok = 0;
+	if (n == 0)
+	    break;
+    }
+    Check("both reads reaped with their lengths", ok && got == 2);
+    Check("data read back matches", Same(in, out, Size));
+
+    for (n = 0; msg[n] != '\0'; n++)
+	;
+    id = WriteAsync(msg, n, ConsoleOutput, 0);
+    Check("console write reaped",
+	  Reap(results, 4, 1) == 1 && results[0].id == id
+	  && results[0].result == n);
+
+    Check("ReadAsync on a file that isn't open fails",
+	  ReadAsync(in, Size, 42, 0) == -1);
+    Check("WriteAsync on a file that isn't open fails",
+	  WriteAsync(out, Size, 42, 0) == -1);
+    Check("Read on a file that isn't open fails", Read(in, Size, 42) == -1);
+    Close(fd);
+    return 0;
+}
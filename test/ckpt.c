@@ -0,0 +1,48 @@
+/* ckpt.c
+ *	Test checkpointing the machine and restoring it (-cksave, -ckload).
+ *
+ *	Fills an array spread over several pages, then keeps working on
+ *	it, printing a running checksum every few rounds.  A checkpoint
+ *	taken part way through must not change the run, and the restored
+ *	run must carry on from where the checkpoint was taken:
+ *
+ *	  nachos -x ckpt > full
+ *	  nachos -cksave ckpt.img 100000 -x ckpt > saved
+ *	  nachos -ckload ckpt.img > restored
+ *
+ *	"saved" is the same as "full", and "restored" is the same as the
+ *	end of "full", starting after the last line printed before the
+ *	checkpoint.  The program opens no files, which would keep it from
+ *	being checkpointed.
+ */
+
+#include "testlib.h"
+
+#define Size	512		/* 16 pages of ints */
+#define Rounds	64
+
+int data[Size];
+
+int
+main()
+{
+    int i, round, sum;
+
+    for (i = 0; i < Size; i++)
+	data[i] = i;
+    for (round = 1; round <= Rounds; round++) {
+	sum = 0;
+	for (i = 0; i < Size; i++) {
+	    data[i] = data[i] * 3 + round;
+	    sum += data[i];
+	}
+	if (round % 8 == 0) {
+	    Print("round ");
+	    PrintInt(round);
+	    Print(" sum ");
+	    PrintInt(sum);
+	    Print("\n");
+	}
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+/* cow.c
+ *	Test that Fork shares the address space copy-on-write.
+ *
+ *	The parent fills an array, then forks.  Each side must still see
+ *	the values from before the fork, and then only its own changes.
+ *	The child tells the parent it is done through a file, since they
+ *	share no memory once either writes.  Run with
+ *
+ *	  nachos -x cow
+ *
+ *	and, to have shared pages evicted to swap as well,
+ *
+ *	  nachos -mem 16 -swap 32 -x cow
+ *
+ *	Every line should start with "ok".  The statistics count the
+ *	pages copied on write.
+ */
+
+#include "testlib.h"
+
+#define Size	128		/* 4 pages of ints */
+
+int data[Size];
+int forked = 0;
+
+int
+All(int base)
+{
+    int i;
+
+    for (i = 0; i < Size; i++)
+	if (data[i] != base + i)
+	    return 0;
+    return 1;
+}
+
+void
+Set(int base)
+{
+    int i;
+
+    for (i = 0; i < Size; i++)
+	data[i] = base + i;
+}
+
+void
+Child()
+{
+    OpenFileId fd;
+
+    Check("child sees the array from before the fork", All(1000));
+    Check("child sees the flag from before the fork", forked == 0);
+    Set(3000);
+    forked = 2;
+    Check("child sees its own changes", All(3000) && forked == 2);
+    fd = Open("cow.tmp");
+    Write("done", 4, fd);
+    Close(fd);
+    Exit(0);
+}
+
+int
+main()
+{
+    OpenFileId fd;
+    char done[4];
+    int n;
+
+    Set(1000);
+    Create("cow.tmp");
+    Fork(Child);
+    forked = 1;
+    Set(2000);
+    Check("parent sees its own changes", All(2000) && forked == 1);
+    do {
+	Yield();
+	fd = Open("cow.tmp");
+	n = Read(done, 4, fd);
+	Close(fd);
+    } while (n < 4);
+    Check("parent's array untouched by the child", All(2000));
+    Check("parent's flag untouched by the child", forked == 1);
+    return 0;
+}
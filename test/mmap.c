@@ -0,0 +1,64 @@
+/* mmap.c
+ *	Test mapping a file into the address space: Mmap and Munmap.
+ *
+ *	Writes a file, maps it, checks what the mapping reads, changes it
+ *	through the mapping, unmaps it and reads the file back.  Run with
+ *
+ *	  nachos -x mmap
+ *
+ *	and, to have the changed pages written back on eviction as well,
+ *
+ *	  nachos -mem 8 -swap 32 -x mmap
+ *
+ *	Every line should start with "ok".
+ */
+
+#include "testlib.h"
+
+#define Size	300		/* not a whole number of pages */
+#define Pages	3		/* what it takes to map it */
+#define PageBytes 128		/* PageSize in the kernel */
+
+char buf[Size];
+
+int
+main()
+{
+    OpenFileId fd;
+    char *p;
+    int i, ok;
+
+    for (i = 0; i < Size; i++)
+	buf[i] = 'a' + i % 26;
+    Create("mmap.tmp");
+    fd = Open("mmap.tmp");
+    Write(buf, Size, fd);
+    Close(fd);
+
+    Check("Mmap of a missing file fails", Mmap("nosuch.tmp") == 0);
+    p = Mmap("mmap.tmp");
+    Check("Mmap returns an address", p != 0);
+    for (i = 0, ok = 1; i < Size; i++)
+	ok = ok && p[i] == buf[i];
+    Check("mapping reads the file", ok);
+    for (ok = 1; i < Pages * PageBytes; i++)
+	ok = ok && p[i] == 0;
+    Check("rest of the last page reads as zeros", ok);
+
+    for (i = 0; i < Size; i++)
+	p[i] = p[i] - 'a' + 'A';
+    Check("Munmap succeeds", Munmap(p) == 0);
+    Check("Munmap again fails", Munmap(p) == -1);
+
+    fd = Open("mmap.tmp");
+    Check("file length unchanged", Read(buf, Size, fd) == Size
+	  && Read(buf, Size, fd) == 0);
+    Close(fd);
+    fd = Open("mmap.tmp");
+    Read(buf, Size, fd);
+    Close(fd);
+    for (i = 0, ok = 1; i < Size; i++)
+	ok = ok && buf[i] == 'A' + i % 26;
+    Check("changes were written back", ok);
+    return 0;
+}
@@ -0,0 +1,58 @@
+/* pagerepl.c
+ *	Test the page replacement policies (-pr).
+ *
+ *	Works on an array several times the size of main memory: a few
+ *	hot pages are used over and over while the rest are swept now
+ *	and then, so the policies evict different pages.  Whatever they
+ *	choose, the program must see the same data.  Run with each policy:
+ *
+ *	  nachos -mem 8 -swap 64 -pr rr -x pagerepl
+ *	  nachos -mem 8 -swap 64 -pr clock -x pagerepl
+ *	  nachos -mem 8 -swap 64 -pr second -x pagerepl
+ *	  nachos -mem 8 -swap 64 -pr wsclock -x pagerepl
+ *	  nachos -mem 8 -swap 64 -pr aging -x pagerepl
+ *
+ *	Every line should start with "ok".  Compare the page faults and
+ *	evictions in the statistics.
+ */
+
+#include "testlib.h"
+
+#define PageInts 32		/* ints per page */
+#define Pages	48
+#define Hot	4		/* pages at the start used all the time */
+#define Rounds	8
+
+int data[Pages * PageInts];
+
+int
+main()
+{
+    int round, i, page, ok;
+
+    for (i = 0; i < Pages * PageInts; i++)
+	data[i] = i;
+    for (round = 1; round <= Rounds; round++) {
+	for (i = 0; i < Hot * PageInts; i++)
+	    data[i] += round;
+	page = Hot + (round - 1) * (Pages - Hot) / Rounds;
+	for (i = page * PageInts; i < Pages * PageInts; i += PageInts)
+	    data[i] += 1;			/* one word per cold page */
+	for (i = 0; i < Hot * PageInts; i++)
+	    data[i] -= round;
+    }
+    for (i = 0, ok = 1; i < Hot * PageInts; i++)
+	ok = ok && data[i] == i;
+    Check("hot pages hold their values", ok);
+    for (page = Hot, ok = 1; page < Pages; page++) {
+	int touched = 0;
+
+	for (round = 1; round <= Rounds; round++)
+	    if (page >= Hot + (round - 1) * (Pages - Hot) / Rounds)
+		touched++;
+	i = page * PageInts;
+	ok = ok && data[i] == i + touched && data[i + 1] == i + 1;
+    }
+    Check("cold pages hold their values", ok);
+    return 0;
+}
@@ -0,0 +1,53 @@
+/* readahead.c
+ *	Test fault-around: reading in the pages after a faulting one (-fa).
+ *
+ *	Reads a mapped file from start to end, then an array that has
+ *	been pushed out to swap, also in order -- the two cases where
+ *	the pages that follow are read in with the one faulted on.  The
+ *	data must be the same with and without it.  Run with
+ *
+ *	  nachos -mem 8 -swap 96 -fa 0 -x readahead
+ *	  nachos -mem 8 -swap 96 -fa 8 -x readahead
+ *
+ *	Every line should start with "ok".  With -fa 8 the statistics
+ *	show fewer page faults, and pages faulted around.
+ */
+
+#include "testlib.h"
+
+#define PageBytes 128		/* PageSize in the kernel */
+#define Pages	32
+
+char buf[Pages * PageBytes];
+char data[Pages * PageBytes];
+
+int
+main()
+{
+    OpenFileId fd;
+    char *p;
+    int i, ok;
+
+    for (i = 0; i < Pages * PageBytes; i++)
+	buf[i] = i % 251;
+    Create("readahead.tmp");
+    fd = Open("readahead.tmp");
+    Write(buf, Pages * PageBytes, fd);
+    Close(fd);
+
+    p = Mmap("readahead.tmp");
+    Check("Mmap returns an address", p != 0);
+    for (i = 0, ok = 1; i < Pages * PageBytes; i++)
+	ok = ok && p[i] == (char) (i % 251);
+    Check("mapped file reads back in order", ok);
+    Munmap(p);
+
+    for (i = 0; i < Pages * PageBytes; i++)
+	data[i] = i % 253;
+    for (i = 0; i < Pages * PageBytes; i++)
+	buf[i] = 0;			/* push "data" out to swap */
+    for (i = 0, ok = 1; i < Pages * PageBytes; i++)
+	ok = ok && data[i] == (char) (i % 253);
+    Check("swapped array reads back in order", ok);
+    return 0;
+}
@@ -0,0 +1,55 @@
+/* replay.c
+ *	Test recording a run and replaying it (-rec, -replay).
+ *
+ *	Two threads count up and print each step.  With -rs the timer
+ *	preempts them at random, so how their lines interleave depends
+ *	on the seed.  Replayed from the log, the run must print exactly
+ *	what the recorded run did, even with a different seed:
+ *
+ *	  nachos -rs 7 -rec replay.log -x replay > recorded
+ *	  nachos -rs 8 -replay replay.log -x replay > replayed
+ *	  cmp recorded replayed
+ */
+
+#include "testlib.h"
+
+#define Steps	20
+#define Work	200
+
+int
+Spin(int seed)
+{
+    int i, x = seed;
+
+    for (i = 0; i < Work; i++)
+	x = x * 1103515245 + 12345;
+    return x;
+}
+
+void
+Count(char *who)
+{
+    int i;
+
+    for (i = 0; i < Steps; i++) {
+	Spin(i);
+	Print(who);
+	PrintInt(i);
+	Print("\n");
+    }
+}
+
+void
+Child()
+{
+    Count("child ");
+    Exit(0);
+}
+
+int
+main()
+{
+    Fork(Child);
+    Count("main ");
+    return 0;
+}
@@ -0,0 +1,75 @@
+/* ring.c
+ *	Test batching system calls through a request ring: RingSetup and
+ *	RingEnter.
+ *
+ *	Creates, writes and reads back a file, a few calls per RingEnter,
+ *	and checks each request's result.  Run with
+ *
+ *	  nachos -x ring
+ *
+ *	Every line should start with "ok".
+ */
+
+#include "testlib.h"
+
+#define Size	300
+
+SyscallRing ring;
+char out[Size], in[Size];
+char *name = "ring.tmp";
+
+/* Queue a request; return its slot. */
+int
+Queue(int op, int arg1, int arg2, int arg3)
+{
+    RingEntry *entry = &ring.entries[ring.tail % RingSize];
+
+    entry->op = op;
+    entry->arg1 = arg1;
+    entry->arg2 = arg2;
+    entry->arg3 = arg3;
+    entry->result = -2;
+    return ring.tail++ % RingSize;
+}
+
+int
+main()
+{
+    int i, fd, create, open, write, close, read, bad;
+
+    for (i = 0; i < Size; i++)
+	out[i] = 'A' + i % 26;
+    Check("RingEnter without a ring fails", RingEnter() == -1);
+    RingSetup(&ring);
+
+    create = Queue(SC_Create, (int) name, 0, 0);
+    open = Queue(SC_Open, (int) name, 0, 0);
+    Check("RingEnter carries out both", RingEnter() == 2);
+    Check("head caught up with tail", ring.head == ring.tail);
+    Check("Create and Open results",
+	  ring.entries[create].result == 0 && ring.entries[open].result > 1);
+    fd = ring.entries[open].result;
+
+    write = Queue(SC_Write, (int) out, Size, fd);
+    close = Queue(SC_Close, fd, 0, 0);
+    open = Queue(SC_Open, (int) name, 0, 0);
+    bad = Queue(SC_Halt, 0, 0, 0);	/* not allowed in a ring */
+    Check("RingEnter carries out all four", RingEnter() == 4);
+    Check("Write result", ring.entries[write].result == Size);
+    Check("Close result", ring.entries[close].result == 0);
+    Check("other calls fail", ring.entries[bad].result == -1);
+    fd = ring.entries[open].result;
+
+    read = Queue(SC_Read, (int) in, Size, fd);
+    close = Queue(SC_Close, fd, 0, 0);
+    Check("RingEnter carries out both", RingEnter() == 2);
+    Check("Read result", ring.entries[read].result == Size);
+    for (i = 0; i < Size && in[i] == out[i]; i++)
+	;
+    Check("data read back matches", i == Size);
+    Check("an empty ring does nothing", RingEnter() == 0);
+
+    RingSetup(0);
+    Check("RingEnter after RingSetup(0) fails", RingEnter() == -1);
+    return 0;
+}
@@ -0,0 +1,49 @@
+/* testlib.c 
+ *	Console output for the test programs.  See testlib.h.
+ */
+
+#include "testlib.h"
+
+static int failures = 0;
+
+void
+Print(char *s)
+{
+    int n;
+
+    for (n = 0; s[n] != '\0'; n++)
+	;
+    Write(s, n, ConsoleOutput);
+}
+
+void
+PrintInt(int n)
+{
+    char buf[12];
+    int i = sizeof(buf);
+    unsigned int u = (n < 0) ? -n : n;
+
+    do {
+	buf[--i] = '0' + u % 10;
+	u /= 10;
+    } while (u != 0);
+    if (n < 0)
+	buf[--i] = '-';
+    Write(buf + i, sizeof(buf) - i, ConsoleOutput);
+}
+
+void
+Check(char *what, int ok)
+{
+    if (!ok)
+	failures++;
+    Print(ok ? "ok: " : "FAIL: ");
+    Print(what);
+    Print("\n");
+}
+
+int
+Failures()
+{
+    return failures;
+}
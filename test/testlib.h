@@ -0,0 +1,19 @@
+/* testlib.h 
+ *	Console output for the test programs, which have no C library:
+ *	strings, numbers, and a line per check saying whether it held.
+ *
+ *	The expected output of each test is given at the top of its
+ *	source; a failed check prints "FAIL" instead of "ok".
+ */
+
+#ifndef TESTLIB_H
+#define TESTLIB_H
+
+#include "syscall.h"
+
+void Print(char *s);		/* write "s" to the console */
+void PrintInt(int n);		/* write "n" in decimal */
+void Check(char *what, int ok);	/* "ok: what" or "FAIL: what" */
+int  Failures();		/* how many checks have failed */
+
+#endif /* TESTLIB_H */
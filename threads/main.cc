@@ -8,8 +8,13 @@
 //
 // 	Most of this file is not needed until later assignments.
 //
-// Usage: nachos -d <debugflags> -rs <random seed #>
-//		-s -x <nachos file> -c <consoleIn> <consoleOut>
+// Usage: nachos -d <debugflags> -rs <random seed #> -np <# of cpus>
+//		-rec <log file> -replay <log file>
+//		-s -e <engine> -hq <ticks> -pf -cost <file> -x <nachos file> 
+//		-cksave <file> <tick> -ckload <file>
+//		-mem <pages> -swap <pages> -tlb <entries> <ways> -pr <policy>
+//		-fa <pages>
+//		-c <consoleIn> <consoleOut>
 //		-f -cp <unix file> <nachos file>
 //		-p <nachos file> -r <nachos file> -l -D -t
 //              -n <network reliability> -m <machine id>
@@ -18,11 +23,35 @@
 //
 //    -d causes certain debugging messages to be printed (cf. utility.h)
 //    -rs causes Yield to occur at random (but repeatable) spots
+//    -np simulates a multiprocessor with the given number of CPUs
+//    -rec records the inputs of the simulation (random numbers, console
+//       and network input) in a log; -replay re-runs the simulation
+//       from such a log, with otherwise the same arguments
 //    -z prints the copyright message
 //
 //  USER_PROGRAM
 //    -s causes user programs to be executed in single-step mode
+//    -e selects the instruction interpreter: switch (default), threaded,
+//       block, jit
+//    -hq with -np, runs the user programs on different CPUs in parallel
+//       on host threads, up to the given number of ticks at a time
+//    -pf profiles each user program, writing <program>.<pid>.prof and
+//       a report, <program>.<pid>.txt, when it exits or halts
+//    -cost reads the cycles each instruction, TLB miss and page fault
+//       costs user code from a file (cf. Machine::LoadCostModel)
 //    -x runs a user program
+//    -cksave checkpoints the whole machine to a file, at the first chance
+//       after the given tick; -ckload carries on from such a checkpoint,
+//       with otherwise the same arguments
+//    -mem, -swap set the number of pages of main memory and swap space
+//       (default 32 and 2); -tlb sets the number of TLB entries, and how
+//       many of them each page may use -- at least 2 (default 4 and 4:
+//       fully associative)
+//    -pr selects the page replacement policy: rr (round robin, default),
+//       clock, second (enhanced second chance), wsclock, aging
+//    -fa sets how many pages at most are read in after the one a page
+//       fault is for, when a program reads through a file or its swap
+//       space in order (default 8; 0 turns it off)
 //    -c tests the console
 //
 //  FILESYS
@@ -135,6 +164,12 @@ int main(int argc, char **argv)
 			StartProcess(*(argv + 1));
 			argCount = 2;
 		}
+		else if (!strcmp(*argv, "-ckload"))
+		{ // carry on from a checkpoint
+			ASSERT(argc > 1);
+			RestoreCheckpoint(*(argv + 1));
+			argCount = 2;
+		}
 		else if (!strcmp(*argv, "-m"))
 		{
 			ASSERT(argc > 1);
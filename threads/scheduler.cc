@@ -27,11 +27,34 @@
 // Scheduler::Scheduler
 // 	Initialize the list of ready but not running threads to empty.
 //  Scheduler对进程状态的改变;
+//
+//	"ncpus" -- how many processors to simulate
 //----------------------------------------------------------------------
 
-Scheduler::Scheduler()
+Scheduler::Scheduler(int ncpus)
 { 
-    readyList = new List; 
+    ASSERT((ncpus >= 1) && (ncpus <= MaxCPUs));
+    numCPUs = ncpus;
+    cpus = new Processor[numCPUs];
+    for (int i = 0; i < numCPUs; i++) {
+	cpus[i].id = i;
+	cpus[i].thread = NULL;
+	cpus[i].readyList = new List;
+	cpus[i].clock = 0;
+	cpus[i].sliceEnd = CpuSlice;
+	cpus[i].idleSince = 0;
+	cpus[i].idleTicks = 0;
+	cpus[i].numDispatches = 0;
+	cpus[i].numSteals = 0;
+	cpus[i].inUser = FALSE;
+#ifdef USER_PROGRAM
+	cpus[i].tlb = NULL;		// allocated on first use
+	cpus[i].tlbOwner = NULL;
+	cpus[i].core = NULL;
+#endif
+    }
+    currentCPU = &cpus[0];
+    hostQuantum = 0;
      // 初始化所有进程列表
     AllThreads = new List;
 } 
@@ -43,7 +66,16 @@ Scheduler::Scheduler()
 
 Scheduler::~Scheduler()
 { 
-    delete readyList;
+    for (int i = 0; i < numCPUs; i++) {
+	delete cpus[i].readyList;
+#ifdef USER_PROGRAM
+	if (cpus[i].tlb != NULL)
+	    delete [] cpus[i].tlb;
+	if (cpus[i].core != NULL)
+	    delete cpus[i].core;
+#endif
+    }
+    delete [] cpus;
     delete AllThreads;
     
 }
@@ -52,6 +84,8 @@ Scheduler::~Scheduler()
 // Scheduler::ReadyToRun
 // 	Mark a thread as ready, but not running.
 //	Put it on the ready list, for later scheduling onto the CPU.
+//	A thread goes back to the processor it last ran on; a new one
+//	starts out on the processor that created it.
 //
 //	"thread" is the thread to be put on the ready list.
 //
@@ -61,6 +95,8 @@ Scheduler::~Scheduler()
 void
 Scheduler::ReadyToRun (Thread *thread)
 {
+    Processor *cpu = (thread->cpu >= 0) ? &cpus[thread->cpu] : currentCPU;
+
     DEBUG('t', "Putting thread %s on ready list.\n", thread->getName());
     thread->setStatus(READY);
 
@@ -69,23 +105,31 @@ Scheduler::ReadyToRun (Thread *thread)
         scheduler->Activate(thread);
 #endif
 
+    thread->cpu = cpu->id;
 #if PRIORITY
     // 带优先级的插入 随时保持顺序..
-    readyList->SortedInsert((void *)thread, thread->getPriority());
+    cpu->readyList->SortedInsert((void *)thread, thread->getPriority());
 #else
     // Append将线程插入列表末端
     // 要被放到队列末尾了..清空线程使用的时间片吧...
     thread->time_used = 0;
-    readyList->Append((void *)thread);
+    cpu->readyList->Append((void *)thread);
     
 #endif
-    
+
+    // An idle processor can't pick the thread up before it was ready.
+    for (int i = 0; i < numCPUs; i++)
+	if ((&cpus[i] != currentCPU) && (cpus[i].thread == NULL)
+				&& (cpus[i].clock < stats->totalTicks))
+	    cpus[i].clock = stats->totalTicks;
 }
 
 //----------------------------------------------------------------------
 // Scheduler::FindNextToRun
 // 	Return the next thread to be scheduled onto the CPU.
 //	If there are no ready threads, return NULL.
+//	When the current processor's own list is empty, it steals
+//	from the others.
 // Side effect:
 //	Thread is removed from the ready list.
 //----------------------------------------------------------------------
@@ -94,7 +138,37 @@ Thread *
 Scheduler::FindNextToRun ()
 {
     // 返回链表最前的元素
-    return (Thread *)readyList->Remove();
+    Thread *thread = (Thread *)currentCPU->readyList->Remove();
+
+    if ((thread == NULL) && (numCPUs > 1))
+	thread = Steal();
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Steal
+// 	Take the oldest thread from the longest ready list of any other
+//	processor.  Return NULL if they are all empty.
+//----------------------------------------------------------------------
+
+Thread *
+Scheduler::Steal()
+{
+    Processor *victim = NULL;
+    Thread *thread;
+
+    for (int i = 0; i < numCPUs; i++)
+	if ((&cpus[i] != currentCPU) && ((victim == NULL) || 
+			(cpus[i].readyList->NumInList() 
+				> victim->readyList->NumInList())))
+	    victim = &cpus[i];
+    if ((victim == NULL) || victim->readyList->IsEmpty())
+	return NULL;
+    thread = (Thread *)victim->readyList->Remove();
+    currentCPU->numSteals++;
+    DEBUG('t', "CPU %d steals thread \"%s\" from CPU %d\n", currentCPU->id,
+	  thread->getName(), victim->id);
+    return thread;
 }
 
 void 
@@ -102,7 +176,7 @@ Scheduler::Suspend(Thread* thread){
 #ifdef USER_PROGRAM
     thread->setStatus(SUSPENDED);
     if (thread->getStatus() == READY)
-        readyList->Remove(thread);
+        cpus[thread->cpu].readyList->Remove(thread);
     thread->Suspend();
 
 #endif
@@ -151,6 +225,13 @@ Scheduler::Run (Thread *nextThread)
 
     currentThread = nextThread;		    // switch to the next thread
     currentThread->setStatus(RUNNING);      // nextThread is now running
+    if (currentCPU->thread != nextThread) { // and it is on this processor
+	if (currentCPU->thread == NULL)
+	    currentCPU->idleTicks += stats->totalTicks - currentCPU->idleSince;
+	currentCPU->thread = nextThread;
+	currentCPU->numDispatches++;
+    }
+    nextThread->cpu = currentCPU->id;
     
     DEBUG('t', "Switching from thread \"%s\" to thread \"%s\"\n",
 	  oldThread->getName(), nextThread->getName());
@@ -195,6 +276,12 @@ Scheduler::Run (Thread *nextThread)
         //  这是在恢复页表和页表大小
         currentThread->space->RestoreState();
     }
+    // If we were only parked while another processor was simulated,
+    // this processor's TLB still holds our translations.
+    if (currentCPU->tlbOwner == currentThread)
+	for (int i = 0; i < TLBSize; i++)
+	    machine->tlb[i] = currentCPU->tlb[i];
+    currentCPU->tlbOwner = NULL;
 #endif
 }
 
@@ -207,7 +294,337 @@ void
 Scheduler::Print()
 {
     printf("Ready list contents:\n");
-    readyList->Mapcar((VoidFunctionPtr) ThreadPrint);
+    for (int i = 0; i < numCPUs; i++)
+	cpus[i].readyList->Mapcar((VoidFunctionPtr) ThreadPrint);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SliceLeft
+// 	Return how many ticks the current processor may still run before
+//	NextSlice has to be called.
+//----------------------------------------------------------------------
+
+int
+Scheduler::SliceLeft()
+{
+    return currentCPU->sliceEnd - stats->totalTicks;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::NextSlice
+// 	The current processor has used up its slice; simulate whichever
+//	processor has fallen furthest behind (possibly this one again).
+//	Called by the interrupt code, the same way as Thread::Yield.
+//
+//	"userMode" is TRUE if the slice ended in the middle of user code.
+//----------------------------------------------------------------------
+
+void
+Scheduler::NextSlice(bool userMode)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    Processor *next;
+
+    currentCPU->inUser = userMode;
+    if (hostQuantum > 0)
+	RunAhead();
+    next = NextCPU();
+    if ((next == NULL) || (next == currentCPU))
+	currentCPU->sliceEnd = stats->totalTicks + CpuSlice;
+    else
+	SwitchCPU(next);
+    currentCPU->inUser = FALSE;		// we are running again
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::RunAhead
+// 	With "-hq", called at the end of every slice to run user code in
+//	parallel.  Every processor whose thread is waiting in the middle
+//	of user code, with a clock no more than a slice past the earliest
+//	busy processor's, gets a core of its own (see Machine::RunDetached)
+//	and runs on a host thread until it is hostQuantum ticks past that
+//	earliest clock, or until its next instruction would trap.  The
+//	kernel then carries on as before, one processor at a time, and 
+//	takes the traps.
+//
+//	Interrupts are not checked while running ahead; the processor 
+//	takes any that fell due at its next tick, at most hostQuantum late.
+//	Two processors whose address spaces map a common frame never run
+//	ahead together, so the host threads never touch the same state.
+//----------------------------------------------------------------------
+
+#ifdef USER_PROGRAM
+static Processor *aheadCPU[MaxCPUs];	// what RunAheadOne is to do
+static int aheadBudget[MaxCPUs];
+static int aheadDone[MaxCPUs];
+
+static void
+RunAheadOne(int which)
+{
+    aheadDone[which] = aheadCPU[which]->core->RunDetached(aheadBudget[which]);
+}
+#endif
+
+void
+Scheduler::RunAhead()
+{
+#ifdef USER_PROGRAM
+    Processor **owner = new Processor *[NumPhysPages];
+				// which processor maps each frame
+    Processor *cpu;
+    Machine *core;
+    Thread *thread;
+    AddrSpace *space;
+    int base = -1, until, count = 0;
+    int i, j, frame;
+    bool clash;
+
+    currentCPU->clock = stats->totalTicks;
+    for (i = 0; i < numCPUs; i++)
+	if ((cpus[i].thread != NULL) && ((base < 0) || (cpus[i].clock < base)))
+	    base = cpus[i].clock;
+    until = base + hostQuantum;
+    for (i = 0; i < NumPhysPages; i++)
+	owner[i] = NULL;
+    if (currentCPU->inUser) {		// park ourselves like the others
+	currentThread->SaveUserState();
+	if (machine->tlb != NULL) {
+	    if (currentCPU->tlb == NULL)
+		currentCPU->tlb = new TranslationEntry[TLBSize];
+	    for (i = 0; i < TLBSize; i++)
+		currentCPU->tlb[i] = machine->tlb[i];
+	    currentCPU->tlbOwner = currentThread;
+	}
+    }
+
+    for (i = 0; i < numCPUs; i++) {
+	cpu = &cpus[i];
+	thread = cpu->thread;
+	if (!cpu->inUser || (cpu->clock > base + CpuSlice) 
+			|| (cpu->clock >= until))
+	    continue;
+	if ((machine->tlb != NULL) && (cpu->tlbOwner != thread))
+	    continue;			// we don't know its TLB
+	space = thread->space;
+	clash = FALSE;
+	for (j = 0; j < (int) space->numPages; j++)
+	    if (space->pageTable[j].valid) {
+		frame = space->pageTable[j].physicalPage;
+		if ((owner[frame] != NULL) && (owner[frame] != cpu))
+		    clash = TRUE;
+	    }
+	if (clash)
+	    continue;
+	for (j = 0; j < (int) space->numPages; j++)
+	    if (space->pageTable[j].valid)
+		owner[space->pageTable[j].physicalPage] = cpu;
+
+	if (cpu->core == NULL)
+	    cpu->core = new Machine(machine);
+	core = cpu->core;
+	for (j = 0; j < NumTotalRegs; j++)
+	    core->registers[j] = thread->userRegisters[j];
+	core->pageTable = space->pageTable;
+	core->pageTableSize = space->numPages;
+	core->profile = space->profile;	// which keeps it in the kernel
+	if (core->tlb != NULL)
+	    for (j = 0; j < TLBSize; j++)
+		core->tlb[j] = cpu->tlb[j];
+	core->tlbHits = 0;
+	core->userInstrs = 0;
+	core->tlbStamp = memTime;
+	aheadCPU[count] = cpu;
+	aheadBudget[count] = (until - cpu->clock) / UserTick;
+	count++;
+    }
+
+    if (count > 0) {
+	DEBUG('t', "Running %d processors ahead to tick %d\n", count, until);
+	RunInParallel(count, RunAheadOne);
+    }
+    for (i = 0; i < count; i++) {
+	cpu = aheadCPU[i];
+	core = cpu->core;
+	for (j = 0; j < NumTotalRegs; j++)
+	    cpu->thread->userRegisters[j] = core->registers[j];
+	if (core->tlb != NULL)
+	    for (j = 0; j < TLBSize; j++)
+		cpu->tlb[j] = core->tlb[j];
+	cpu->clock += aheadDone[i] * UserTick;
+	stats->userTicks += aheadDone[i] * UserTick;
+	stats->numTLBHits += core->tlbHits;
+	stats->numUserInstrs += core->userInstrs;
+	if (core->tlbStamp > memTime)
+	    memTime = core->tlbStamp;
+    }
+
+    if (currentCPU->inUser) {		// and pick up where we got to
+	stats->totalTicks = currentCPU->clock;
+	currentThread->RestoreUserState();
+	if (machine->tlb != NULL) {
+	    for (i = 0; i < TLBSize; i++)
+		machine->tlb[i] = currentCPU->tlb[i];
+	    currentCPU->tlbOwner = NULL;
+	}
+	machine->FlushSoftTLB();
+    }
+    delete [] owner;
+#endif
+}
+
+//----------------------------------------------------------------------
+// Scheduler::IdleCPU
+// 	Called by Thread::Sleep when the current processor has nothing
+//	left to run.  If some other processor is busy, simulate it instead,
+//	and return TRUE once the sleeping thread has been dispatched again
+//	(on any processor).  Otherwise return FALSE, and the caller waits
+//	for an interrupt as on a uniprocessor.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::IdleCPU()
+{
+    Processor *next;
+
+    if (currentCPU->thread != NULL) {
+	currentCPU->thread = NULL;
+	currentCPU->idleSince = stats->totalTicks;
+    }
+    if (numCPUs == 1)
+	return FALSE;
+    next = NextCPU();
+    if ((next == NULL) || (next == currentCPU))
+	return FALSE;
+    SwitchCPU(next);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::NextCPU
+// 	Return the processor with the earliest clock among those that
+//	have something to do -- a thread, or a ready list to take work 
+//	from -- or NULL if every processor is idle.  Ties go round-robin.
+//----------------------------------------------------------------------
+
+Processor *
+Scheduler::NextCPU()
+{
+    Processor *best = NULL;
+    bool work = FALSE;
+
+    currentCPU->clock = stats->totalTicks;
+    for (int i = 0; i < numCPUs; i++)
+	if (!cpus[i].readyList->IsEmpty())
+	    work = TRUE;
+    for (int n = 1; n <= numCPUs; n++) {
+	Processor *cpu = &cpus[(currentCPU->id + n) % numCPUs];
+
+	if ((cpu->thread == NULL) && !work)
+	    continue;
+	if ((best == NULL) || (cpu->clock < best->clock))
+	    best = cpu;
+    }
+    return best;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SwitchCPU
+// 	Park the current processor, and continue with "next": its clock
+//	becomes the time, its TLB the machine's, and its thread (or, if
+//	it was idle, the first one it can find) gets dispatched.
+//
+//	"next" is the processor to simulate.
+//----------------------------------------------------------------------
+
+void
+Scheduler::SwitchCPU(Processor *next)
+{
+    Processor *from = currentCPU;
+    Thread *nextThread;
+
+    from->clock = stats->totalTicks;
+#ifdef USER_PROGRAM
+    if ((from->thread == currentThread) && (currentThread->space != NULL)
+					&& (machine->tlb != NULL)) {
+	if (from->tlb == NULL)
+	    from->tlb = new TranslationEntry[TLBSize];
+	for (int i = 0; i < TLBSize; i++)
+	    from->tlb[i] = machine->tlb[i];
+	from->tlbOwner = currentThread;
+    }
+#endif
+    DEBUG('t', "Switching from CPU %d to CPU %d at tick %d\n", from->id,
+	  next->id, next->clock);
+
+    currentCPU = next;
+    stats->totalTicks = next->clock;
+    next->sliceEnd = next->clock + CpuSlice;
+    nextThread = next->thread;
+    if (nextThread == NULL)
+	nextThread = FindNextToRun();
+    ASSERT(nextThread != NULL);
+    Run(nextThread);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::InvalidateTLBs
+// 	Remove a physical page from the TLBs of the processors we are not
+//	simulating right now; the caller takes care of the machine's.
+//
+//	"page" is the physical page being reused.
+//----------------------------------------------------------------------
+
+void
+Scheduler::InvalidateTLBs(int page)
+{
+#ifdef USER_PROGRAM
+    for (int i = 0; i < numCPUs; i++)
+	if (cpus[i].tlbOwner != NULL)
+	    for (int j = 0; j < TLBSize; j++)
+		if (cpus[i].tlb[j].physicalPage == page)
+		    cpus[i].tlb[j].valid = FALSE;
+#endif
+}
+
+//----------------------------------------------------------------------
+// Scheduler::ElapsedTicks
+// 	Return how far the simulation has got: the latest clock of any
+//	processor.
+//----------------------------------------------------------------------
+
+int
+Scheduler::ElapsedTicks()
+{
+    int elapsed = stats->totalTicks;
+
+    for (int i = 0; i < numCPUs; i++)
+	if ((&cpus[i] != currentCPU) && (cpus[i].clock > elapsed))
+	    elapsed = cpus[i].clock;
+    return elapsed;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::PrintCPUs
+// 	Print per-processor statistics, when we've finished everything.
+//----------------------------------------------------------------------
+
+void
+Scheduler::PrintCPUs()
+{
+    int elapsed = ElapsedTicks();
+
+    for (int i = 0; i < numCPUs; i++) {
+	Processor *cpu = &cpus[i];
+	int idle = cpu->idleTicks;
+
+	if (cpu->thread == NULL)	// still idle, to the end
+	    idle += elapsed - cpu->idleSince;
+	else if (cpu != currentCPU)	// busy, but not simulated that far
+	    idle += elapsed - cpu->clock;
+	printf("CPU %d: ticks busy %d, idle %d, dispatches %d, steals %d\n",
+	       i, elapsed - idle, idle, cpu->numDispatches, cpu->numSteals);
+    }
 }
 
 
@@ -13,6 +13,45 @@
 #include "list.h"
 #include "thread.h"
 
+#define MaxCPUs		16	// most simulated processors "-np" accepts
+#define CpuSlice	100	// ticks one processor is simulated for
+				// before the lagging one catches up
+
+// The following class defines one simulated processor.  Every processor
+// has its own ready queue, its own TLB and its own notion of the time;
+// the Machine register file is loaded from whichever thread the 
+// processor is running each time we switch to it.
+//
+// Processors are simulated one at a time on the host: the one whose
+// clock lags furthest behind runs for CpuSlice ticks, then the next
+// laggard takes over, so their clocks never drift more than a slice 
+// apart.  While a processor runs, stats->totalTicks is its clock.
+
+class Processor {
+  public:
+    int id;
+    Thread *thread;		// running on this processor; NULL if idle
+    List *readyList;		// queue of threads that are ready to run
+				// here, but not running
+    int clock;			// local time, while some other processor
+				// is being simulated
+    int sliceEnd;		// when to let the next processor catch up
+    int idleSince;		// when "thread" last became NULL
+    bool inUser;		// TRUE while its thread waits for its next
+				// slice in the middle of user code
+
+    int idleTicks;		// statistics
+    int numDispatches;
+    int numSteals;
+
+#ifdef USER_PROGRAM
+    TranslationEntry *tlb;	// TLB contents, while some other 
+    Thread *tlbOwner;		// processor is being simulated
+    Machine *core;		// runs its user code on a host thread;
+				// NULL until first needed
+#endif
+};
+
 // The following class defines the scheduler/dispatcher abstraction -- 
 // the data structures and operations needed to keep track of which 
 // thread is running, and which threads are ready but not running.
@@ -20,8 +59,13 @@
 class Scheduler {
   public:
     List *AllThreads;
+    int numCPUs;			// number of simulated processors
+    Processor *cpus;
+    Processor *currentCPU;		// the one being simulated now
+    int hostQuantum;			// if > 0, run user code on host 
+					// threads, this many ticks at a time
 
-    Scheduler();			// Initialize list of ready threads 
+    Scheduler(int ncpus = 1);		// Initialize list of ready threads 
     ~Scheduler();			// De-allocate ready list
 
     void ReadyToRun(Thread* thread);	// Thread can be dispatched.
@@ -34,11 +78,23 @@ class Scheduler {
     void Activate(Thread *thread);
 
     void PrintAllThreads();
+
+    int SliceLeft();			// ticks before the next processor
+					// must be simulated
+    void NextSlice(bool userMode);	// let the lagging processor run
+    bool IdleCPU();			// current thread blocked and there is
+					// nothing to run; give the host to 
+					// a busy processor
+    void InvalidateTLBs(int page);	// "page" is being taken away
+    int ElapsedTicks();			// latest clock of any processor
+    void PrintCPUs();			// Print per-processor statistics
     
   private:
-    List *readyList;  		// queue of threads that are ready to run,
-				// but not running
-    
+    Processor *NextCPU();		// which processor to simulate next
+    void SwitchCPU(Processor *next);	// start simulating "next"
+    Thread *Steal();			// take work from another processor
+    void RunAhead();			// run processors' user code in 
+					// parallel on host threads
 };
 
 #endif // SCHEDULER_H
@@ -28,6 +28,8 @@ Interrupt *interrupt;			// interrupt status
 Statistics *stats;			// performance metrics
 Timer *timer;				// the hardware timer device,
 					// for invoking context switches
+TraceLog *traceLog;			// nondeterministic inputs, logged
+					// (-rec) or replayed (-replay)
 
 #ifdef FILESYS_NEEDED
 FileSystem  *fileSystem;
@@ -39,6 +41,10 @@ SynchDisk   *synchDisk;     // 磁盘
 
 #ifdef USER_PROGRAM	// requires either FILESYS or FILESYS_STUB
 Machine *machine;	// 用户程序内存、寄存器、MIPS模拟器
+bool profileUser;	// profile every user program we start
+char *checkpointFile;	// where to checkpoint the machine (-cksave),
+int checkpointTick;	// at the first chance after this tick; -1 if not
+AsyncIO *asyncIO;	// queue of asynchronous I/O requests
 #endif              
 
 #ifdef NETWORK
@@ -105,9 +111,22 @@ Initialize(int argc, char **argv)
     int argCount;
     char* debugArgs = "";
     bool randomYield = FALSE;
+    int numCPUs = 1;		// simulated processors
+    TraceMode traceMode = TraceOff;	// record or replay inputs
+    char *traceFile = NULL;
 
 #ifdef USER_PROGRAM
     bool debugUserProg = FALSE;	// single step user program
+    ExecEngine engine = SwitchEngine;	// user program interpreter loop
+    ReplacePolicy replacePolicy = RoundRobin;	// page replacement
+    int faultAround = DefaultFaultAround;	// pages brought in with
+						// the one faulted on
+    int hostQuantum = 0;		// run user code on host threads
+    char *costFile = NULL;		// cost model for user code
+
+    profileUser = FALSE;
+    checkpointFile = NULL;
+    checkpointTick = -1;
 #endif
 #ifdef FILESYS_NEEDED
     bool format = FALSE;	// format disk
@@ -132,10 +151,83 @@ Initialize(int argc, char **argv)
 						// number generator
 	    randomYield = TRUE;
 	    argCount = 2;
+	} else if (!strcmp(*argv, "-np")) {
+	    ASSERT(argc > 1);
+	    numCPUs = atoi(*(argv + 1));
+	    ASSERT((numCPUs >= 1) && (numCPUs <= MaxCPUs));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-rec") || !strcmp(*argv, "-replay")) {
+	    ASSERT(argc > 1);
+	    traceMode = strcmp(*argv, "-rec") ? TraceReplay : TraceRecord;
+	    traceFile = *(argv + 1);
+	    argCount = 2;
 	}
 #ifdef USER_PROGRAM
 	if (!strcmp(*argv, "-s"))
 	    debugUserProg = TRUE;
+	else if (!strcmp(*argv, "-e")) {
+	    ASSERT(argc > 1);
+	    if (!strcmp(*(argv + 1), "threaded"))
+		engine = ThreadedEngine;
+	    else if (!strcmp(*(argv + 1), "block"))
+		engine = BlockEngine;
+	    else if (!strcmp(*(argv + 1), "jit"))
+		engine = JitEngine;
+	    else
+		ASSERT(!strcmp(*(argv + 1), "switch"));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-pr")) {
+	    ASSERT(argc > 1);
+	    if (!strcmp(*(argv + 1), "clock"))
+		replacePolicy = ClockPolicy;
+	    else if (!strcmp(*(argv + 1), "second"))
+		replacePolicy = SecondChance;
+	    else if (!strcmp(*(argv + 1), "wsclock"))
+		replacePolicy = WSClockPolicy;
+	    else if (!strcmp(*(argv + 1), "aging"))
+		replacePolicy = AgingPolicy;
+	    else
+		ASSERT(!strcmp(*(argv + 1), "rr"));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-fa")) {
+	    ASSERT(argc > 1);
+	    faultAround = atoi(*(argv + 1));
+	    ASSERT((faultAround >= 0) && (faultAround <= MaxFaultAround));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-hq")) {
+	    ASSERT(argc > 1);
+	    hostQuantum = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-pf"))
+	    profileUser = TRUE;
+	else if (!strcmp(*argv, "-cost")) {
+	    ASSERT(argc > 1);
+	    costFile = *(argv + 1);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-cksave")) {
+	    ASSERT(argc > 2);
+	    checkpointFile = *(argv + 1);
+	    checkpointTick = atoi(*(argv + 2));
+	    argCount = 3;
+	} else if (!strcmp(*argv, "-mem")) {
+	    ASSERT(argc > 1);
+	    NumPhysPages = atoi(*(argv + 1));
+	    ASSERT((NumPhysPages >= 2) && (NumPhysPages <= MaxPhysPages));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-swap")) {
+	    ASSERT(argc > 1);
+	    NumSwapPages = atoi(*(argv + 1));
+	    ASSERT(NumSwapPages >= 1);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-tlb")) {
+	    ASSERT(argc > 2);
+	    TLBSize = atoi(*(argv + 1));
+	    TLBWays = atoi(*(argv + 2));
+	    // An instruction and the data it touches may need two entries
+	    // of the same set at once, or it never completes
+	    ASSERT((TLBWays >= 2) && (TLBSize % TLBWays == 0));
+	    argCount = 3;
+	}
 #endif
 #ifdef FILESYS_NEEDED
 	if (!strcmp(*argv, "-f"))
@@ -154,10 +246,17 @@ Initialize(int argc, char **argv)
 #endif
     }
 
+#ifdef USER_PROGRAM
+    ASSERT((checkpointTick < 0) || (numCPUs == 1));	// see checkpoint.cc
+#endif
+
     DebugInit(debugArgs);			// initialize DEBUG messages
     stats = new Statistics();			// collect statistics
+    traceLog = new TraceLog(traceMode, traceFile, randomYield);
+    if (traceLog->Replaying())			// as when it was recorded
+	randomYield = traceLog->randomYield;
     interrupt = new Interrupt;			// start up interrupt handling
-    scheduler = new Scheduler();		// initialize the ready queue
+    scheduler = new Scheduler(numCPUs);		// initialize the ready queues
     //if (randomYield)				// start the timer (if needed)
 	timer = new Timer(TimerInterruptHandler, 0, randomYield);
 
@@ -179,12 +278,22 @@ Initialize(int argc, char **argv)
     // 
     currentThread = new Thread("main");		
     currentThread->setStatus(RUNNING);
+    currentThread->cpu = scheduler->currentCPU->id;
+    scheduler->currentCPU->thread = currentThread;
 
     interrupt->Enable();
     CallOnUserAbort(Cleanup);			// if user hits ctl-C
     
 #ifdef USER_PROGRAM
     machine = new Machine(debugUserProg);	// this must come first
+    machine->engine = engine;
+    machine->replacePolicy = replacePolicy;
+    machine->faultAround = faultAround;
+    stats->replacePolicy = replacePolicyNames[replacePolicy];
+    if (costFile != NULL)
+	machine->LoadCostModel(costFile);
+    scheduler->hostQuantum = hostQuantum;
+    asyncIO = new AsyncIO();
 #endif
 
 #ifdef FILESYS
@@ -222,6 +331,7 @@ Cleanup()
 #endif
     
 #ifdef USER_PROGRAM
+    delete asyncIO;
     delete machine;
 #endif
 
@@ -236,6 +346,7 @@ Cleanup()
     delete timer;
     delete scheduler;
     delete interrupt;
+    delete traceLog;
     
     Exit(0);
 }
@@ -19,6 +19,7 @@
 #include "interrupt.h"
 #include "stats.h"
 #include "timer.h"
+#include "tracelog.h"
 
 // 添加最大进程数量限制...!
 #define MaxThreadNum 128
@@ -43,10 +44,20 @@ extern Scheduler *scheduler;			// the ready list
 extern Interrupt *interrupt;			// interrupt status
 extern Statistics *stats;			// performance metrics
 extern Timer *timer;				// the hardware alarm clock
+extern TraceLog *traceLog;			// inputs recorded or replayed
 
 #ifdef USER_PROGRAM
 #include "machine.h"
 extern Machine* machine;	// user program memory and registers
+extern bool profileUser;	// profile user programs (-pf)
+extern char *checkpointFile;	// checkpoint the machine to this file
+extern int checkpointTick;	// once past this tick (-cksave), or -1
+
+extern bool SaveCheckpoint(char *fileName);	// see checkpoint.cc
+extern void RestoreCheckpoint(char *fileName);
+
+#include "aio.h"
+extern AsyncIO *asyncIO;	// user programs' asynchronous I/O
 #endif
 
 #ifdef FILESYS_NEEDED 		// FILESYS or FILESYS_STUB 
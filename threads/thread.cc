@@ -57,6 +57,7 @@ Thread::Thread(char* threadName, int priorityLevel = minPriority)
     priority = priorityLevel;
     (void) interrupt->SetLevel(oldLevel);
     time_used = 0;
+    cpu = -1;
 
     // 将此进程添加到所有进程表里...
     scheduler->AllThreads->SortedInsert((void *)this, tid);
@@ -64,6 +65,10 @@ Thread::Thread(char* threadName, int priorityLevel = minPriority)
 
 #ifdef USER_PROGRAM
     space = NULL;
+    executable = NULL;
+    executableName = NULL;
+    preempted = FALSE;
+    syscallRing = 0;
     // 在StartProgress中赋值
     // 初始化打开文件表
     openFiles = new List();
@@ -312,8 +317,11 @@ Thread::Sleep ()
     DEBUG('t', "Sleeping thread \"%s\"\n", getName());
 
     status = BLOCKED;
-    while ((nextThread = scheduler->FindNextToRun()) == NULL)
+    while ((nextThread = scheduler->FindNextToRun()) == NULL) {
+	if (scheduler->IdleCPU())
+	    return;		// another processor has dispatched us
 	interrupt->Idle();	// no one to run, wait for an interrupt
+    }
 
     scheduler->Run(nextThread); // returns when we've been signalled
 }
@@ -324,12 +332,14 @@ Thread::Suspend(){
 #ifdef USER_PROGRAM
     for (int i = 0; i < space->numPages;i++){
         TranslationEntry *pte = space->pageTable + i;
-        if (pte->valid &&pte->dirty){
+        if (pte->valid &&pte->dirty
+            && machine->frames[pte->physicalPage].refCount == 1){  // 共享的页框留给别人
             SwapoutPage(pte->physicalPage);
-            machine->memoryMap->Clear(pte->physicalPage);
+            ReleaseFrame(space, i);
             pte->valid = FALSE;
         }
     }
+    machine->FlushSoftTLB();
 #endif
 }
 
@@ -458,6 +468,25 @@ Thread::TidAllocate ()
         }
 }
 
+//----------------------------------------------------------------------
+// Thread::SetTid
+// 	Give up our TID for "newTid", which must be free; used to give a
+//	thread restored from a checkpoint the TID it had when saved.
+//----------------------------------------------------------------------
+
+void
+Thread::SetTid(int newTid)
+{
+    ASSERT((newTid >= 0) && (newTid < MaxThreadNum));
+    if (newTid == tid)
+        return;
+    ASSERT(!TidPool[newTid]);
+    TidPool[tid] = 0;
+    TidPool[newTid] = 1;
+    scheduler->AllThreads->Remove(this);
+    tid = newTid;
+    scheduler->AllThreads->SortedInsert((void *)this, tid);
+}
 
 //----------------------------------------------------------------------
 //  是Thread::Print的强化版本
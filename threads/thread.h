@@ -146,6 +146,9 @@
       // 记录上次运行时候系统的时刻SystemTick
       int last_tick;
 
+      int cpu;				// processor it last ran or was
+					// queued on; -1 if never
+
       //private:
       // some of the private data for this class is listed above
       int* stack; 	 		// Bottom of the stack 
@@ -160,6 +163,8 @@
             // Used internally by Fork()
 
       int TidAllocate();
+      void SetTid(int newTid);		// take over another TID (when
+					// restoring a checkpoint)
       
 
   #ifdef USER_PROGRAM
@@ -176,6 +181,11 @@
 
       AddrSpace *space;			// User code this thread is running.
       OpenFile *executable;
+      char *executableName;		// the file it was loaded from
+      bool preempted;			// TRUE while switched out by the
+					// timer in the middle of user code
+      int syscallRing;			// user address of its SyscallRing,
+					// or 0
       List *openFiles;
       
 #endif
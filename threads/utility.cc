@@ -21,7 +21,8 @@
 #endif
 #endif
 
-static char *enableFlags = NULL; // controls which DEBUG messages are printed 
+unsigned int debugMask[256 / 32];	// controls which DEBUG messages 
+					// are printed 
 
 //----------------------------------------------------------------------
 // DebugInit
@@ -37,39 +38,36 @@ static char *enableFlags = NULL; // controls which DEBUG messages are printed
 void
 DebugInit(char *flagList)
 {
-    enableFlags = flagList;
-}
-
-//----------------------------------------------------------------------
-// DebugIsEnabled
-//      Return TRUE if DEBUG messages with "flag" are to be printed.
-//----------------------------------------------------------------------
+    int i;
 
-bool
-DebugIsEnabled(char flag)
-{
-    if (enableFlags != NULL)
-       return (strchr(enableFlags, flag) != 0) 
-		|| (strchr(enableFlags, '+') != 0);
-    else
-      return FALSE;
+    for (i = 0; i < 256 / 32; i++)
+	debugMask[i] = 0;
+    if (flagList == NULL)
+	return;
+    for (; *flagList != '\0'; flagList++) {
+	if (*flagList == '+') {
+	    for (i = 0; i < 256 / 32; i++)
+		debugMask[i] = ~0;
+	    return;
+	}
+	debugMask[(unsigned char) *flagList / 32] 
+		|= 1 << ((unsigned char) *flagList % 32);
+    }
 }
 
 //----------------------------------------------------------------------
-// DEBUG
-//      Print a debug message, if flag is enabled.  Like printf,
-//	only with an extra argument on the front.
+// DebugPrint
+//      Print a debug message.  Like printf; used by the DEBUG macro
+//	once it has checked that the message's flag is enabled.
 //----------------------------------------------------------------------
 
 void 
-DEBUG(char flag, char *format, ...)
+DebugPrint(char *format, ...)
 {
-    if (DebugIsEnabled(flag)) {
-	va_list ap;
-	// You will get an unused variable message here -- ignore it.
-	va_start(ap, format);
-	vfprintf(stdout, format, ap);
-	va_end(ap);
-	fflush(stdout);
-    }
+    va_list ap;
+    // You will get an unused variable message here -- ignore it.
+    va_start(ap, format);
+    vfprintf(stdout, format, ap);
+    va_end(ap);
+    fflush(stdout);
 }
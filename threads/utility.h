@@ -59,13 +59,54 @@ typedef void (*VoidNoArgFunctionPtr)();
 #include "sysdep.h"				
 
 // Interface to debugging routines.
+//
+// A debug flag is tested at two levels.  DEBUG_CATEGORIES (set in
+// Makefile.common) lists the flags compiled into the program, "+" for 
+// all of them; testing any other flag is a compile-time FALSE, so its
+// DEBUG messages generate no code.  The flags enabled with -d are kept
+// in a bitmask, so the run-time test is a single lookup.
+//
+// Flags must be character constants, as they are everywhere in Nachos.
+
+#ifndef DEBUG_CATEGORIES
+#define DEBUG_CATEGORIES "+"
+#endif
 
 extern void DebugInit(char* flags);	// enable printing debug messages
 
-extern bool DebugIsEnabled(char flag); 	// Is this debug flag enabled?
+extern unsigned int debugMask[256 / 32]; // one bit per enabled flag
 
-extern void DEBUG (char flag, char* format, ...);  	// Print debug message 
-							// if flag is enabled
+extern void DebugPrint(char* format, ...); // Print debug message
+
+// Is "flag" one of "categories"?  Evaluated by the compiler.
+static inline constexpr bool
+DebugIsCompiled(char flag, const char *categories = DEBUG_CATEGORIES)
+{
+    return *categories != '\0'
+	&& (*categories == flag || *categories == '+'
+	    || DebugIsCompiled(flag, categories + 1));
+}
+
+// Is "flag" enabled at run time?  Only instantiated for compiled-in flags.
+template <bool compiled> struct DebugFlag {
+    static inline bool IsOn(char flag) {
+	return (debugMask[(unsigned char) flag / 32] 
+		>> ((unsigned char) flag % 32)) & 1;
+    }
+};
+template <> struct DebugFlag<false> {
+    static inline bool IsOn(char) { return FALSE; }
+};
+
+// Is this debug flag enabled?
+#define DebugIsEnabled(flag) (DebugFlag<DebugIsCompiled(flag)>::IsOn(flag))
+
+// Print debug message if flag is enabled
+#define DEBUG(flag, ...)						      \
+    do {								      \
+	if (DebugIsEnabled(flag))					      \
+	    DebugPrint(__VA_ARGS__);					      \
+    } while (0)
 
 //----------------------------------------------------------------------
 // ASSERT
@@ -63,6 +63,53 @@ AddrSpace::AddrSpace(AddrSpace* cpy){
     numPages = cpy->numPages;
     pageTable = new TranslationEntry[numPages];
     memcpy(pageTable, cpy->pageTable, numPages * sizeof(TranslationEntry));
+    // 写时复制: 内存中的页框两边共享 都改为只读 谁先写谁复制
+    // 换出的页面两边共享同一个交换页 各自换入
+    for (unsigned int vpn = 0; vpn < numPages; vpn++) {
+        TranslationEntry *entry = &pageTable[vpn];
+        if (entry->valid) {
+            ShareFrame(entry->physicalPage, this);
+            if (!entry->readOnly)
+                entry->readOnly = entry->copyOnWrite = TRUE;
+            cpy->pageTable[vpn].readOnly = entry->readOnly;
+            cpy->pageTable[vpn].copyOnWrite = entry->copyOnWrite;
+        } else if (entry->dirty && entry->swapPage >= 0)
+            ShareSwap(entry, entry->swapPage);
+    }
+    if (machine->pageTable == cpy->pageTable) {   // 父进程已缓存的可写翻译作废
+        if (machine->tlb != NULL)
+            for (int i = 0; i < TLBSize; i++)
+                machine->tlb[i].valid = false;
+        machine->FlushSoftTLB();
+    }
+    if (cpy->profile != NULL)		// the child gets a profile of its own
+        profile = new Profile(cpy->profile->program, numPages * PageSize);
+    else
+        profile = NULL;
+    // 映射的文件 子进程各自再打开一次
+    basePages = cpy->basePages;
+    nextFault = faultWindow = 0;
+    numMappings = cpy->numMappings;
+    for (int m = 0; m < numMappings; m++) {
+        mappings[m] = cpy->mappings[m];
+        mappings[m].name = new char[strlen(cpy->mappings[m].name) + 1];
+        strcpy(mappings[m].name, cpy->mappings[m].name);
+        mappings[m].file = fileSystem->Open(mappings[m].name);
+        ASSERT(mappings[m].file != NULL);
+        for (int vpn = mappings[m].firstPage;
+             vpn < mappings[m].firstPage + mappings[m].numPages; vpn++)
+            pageTable[vpn].mappedFile = mappings[m].file;
+    }
+}
+
+AddrSpace::AddrSpace(unsigned int size)
+{
+    numPages = size;
+    pageTable = new TranslationEntry[numPages];
+    profile = NULL;
+    numMappings = 0;
+    basePages = numPages;
+    nextFault = faultWindow = 0;
 }
 
 AddrSpace::AddrSpace(OpenFile *executable)
@@ -96,17 +143,23 @@ AddrSpace::AddrSpace(OpenFile *executable)
 // PageTable 是全局变量
 // 页表的第i项属于VPN[i]
     pageTable = new TranslationEntry[numPages];
+    profile = NULL;			// StartProcess may start one
+    numMappings = 0;
+    basePages = numPages;
+    nextFault = faultWindow = 0;
 // 初始化一个位图
 
     for (i = 0; i < numPages; i++) {
         DEBUG('a', "Initializing PTE %d...\n", i);
         pageTable[i].virtualPage = i;
-        pageTable[i].physicalPage = GetPage(pageTable+i, true);
+        pageTable[i].physicalPage = GetPage(this, i, true);
         pageTable[i].swapPage = -1;
         pageTable[i].fileAddr = -1;
+        pageTable[i].mappedFile = NULL;
         pageTable[i].valid = pageTable[i].physicalPage<0?FALSE:TRUE;
         pageTable[i].use = FALSE;
         pageTable[i].dirty = FALSE;
+        pageTable[i].copyOnWrite = FALSE;
         pageTable[i].readOnly = FALSE;           // if the code segment was entirely on
                                                  // a separate page, we could set its pages to be read-only 哦哦...这样啊
         //ASSERT(pageTable[i].physicalPage != -1); // 确保不是没有空间了...
@@ -158,7 +211,12 @@ AddrSpace::AddrSpace(OpenFile *executable)
 
 AddrSpace::~AddrSpace()
 {
+   UnmapAll();
+   machine->FlushBlocks(pageTable);
    delete pageTable;
+   if (machine->profile == profile)
+       machine->profile = NULL;
+   delete profile;
 }
 
 //----------------------------------------------------------------------
@@ -208,6 +266,7 @@ void AddrSpace::SaveState()
     if (machine->tlb!=NULL)
         for (int i = 0; i < TLBSize;i++)
             machine->tlb[i].valid = false;       
+    machine->FlushSoftTLB();
 }
 
 //----------------------------------------------------------------------
@@ -222,5 +281,171 @@ void AddrSpace::RestoreState()
 {
     machine->pageTable = pageTable;
     machine->pageTableSize = numPages;
+    machine->profile = profile;
+    machine->FlushSoftTLB();
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Map
+// 	Map the file "name" into the address space, just above the top
+//	of it, and return the address it starts at -- or 0 if the file
+//	doesn't exist, is empty, or too many files are mapped already.
+//
+//	Nothing is read yet: each page records where in the file it
+//	comes from, as the pages of the executable do, and is loaded
+//	from there on its first page fault.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::Map(char *name)
+{
+    Mapping *mapping;
+    OpenFile *file;
+    int length, vpn;
+
+    if (numMappings == MaxMappings)
+	return 0;
+    if ((file = fileSystem->Open(name)) == NULL)
+	return 0;
+    if ((length = file->Length()) <= 0) {
+	delete file;
+	return 0;
+    }
+    mapping = &mappings[numMappings++];
+    mapping->firstPage = numPages;
+    mapping->numPages = divRoundUp(length, PageSize);
+    mapping->file = file;
+    mapping->name = new char[strlen(name) + 1];
+    strcpy(mapping->name, name);
+
+    Grow(numPages + mapping->numPages);
+    for (vpn = mapping->firstPage; vpn < (int) numPages; vpn++) {
+	pageTable[vpn].virtualPage = vpn;
+	pageTable[vpn].physicalPage = -1;
+	pageTable[vpn].swapPage = -1;
+	pageTable[vpn].fileAddr = (vpn - mapping->firstPage) * PageSize;
+	pageTable[vpn].mappedFile = file;
+	pageTable[vpn].valid = FALSE;
+	pageTable[vpn].readOnly = FALSE;
+	pageTable[vpn].copyOnWrite = FALSE;
+	pageTable[vpn].use = FALSE;
+	pageTable[vpn].dirty = FALSE;
+	pageTable[vpn].last_used = 0;
+    }
+    DEBUG('a', "Mapped %s at page %d, %d pages\n", name, mapping->firstPage,
+	  mapping->numPages);
+    return mapping->firstPage * PageSize;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Unmap
+// 	Unmap the file mapped at "addr": write the pages that were
+//	changed back to the file, and free their frames.  Return FALSE if
+//	no file is mapped there.
+//
+//	If nothing is mapped above it any more, the address space shrinks
+//	back, freeing whatever the program put in the holes left by files
+//	unmapped earlier (which it uses as ordinary memory meanwhile).
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::Unmap(int addr)
+{
+    Mapping *mapping;
+    unsigned int top;
+    int m, vpn;
+
+    for (m = 0; m < numMappings; m++)
+	if (mappings[m].firstPage * PageSize == addr)
+	    break;
+    if (m == numMappings)
+	return FALSE;
+    mapping = &mappings[m];
+
+    for (vpn = mapping->firstPage;
+	    vpn < mapping->firstPage + mapping->numPages; vpn++) {
+	if (pageTable[vpn].valid && pageTable[vpn].dirty)
+	    WritebackPage(&pageTable[vpn]);
+	ReleasePage(vpn);
+    }
+    delete mapping->file;
+    delete [] mapping->name;
+    mappings[m] = mappings[--numMappings];
+
+    top = basePages;
+    for (m = 0; m < numMappings; m++)
+	if (mappings[m].firstPage + mappings[m].numPages > (int) top)
+	    top = mappings[m].firstPage + mappings[m].numPages;
+    for (vpn = top; vpn < (int) numPages; vpn++)
+	ReleasePage(vpn);
+    numPages = top;
+    if (machine->pageTable == pageTable)
+	machine->pageTableSize = numPages;
+    machine->FlushSoftTLB();
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::UnmapAll
+// 	Unmap every file still mapped, when the program exits.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::UnmapAll()
+{
+    while (numMappings > 0)
+	Unmap(mappings[numMappings - 1].firstPage * PageSize);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Grow
+// 	Enlarge the page table to "size" entries, keeping the ones in
+//	use.  The frame table knows pages by virtual page number, so it
+//	is unaffected; translated blocks know the old table, so they are
+//	thrown away.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::Grow(unsigned int size)
+{
+    TranslationEntry *oldTable = pageTable;
+
+    pageTable = new TranslationEntry[size];
+    memcpy(pageTable, oldTable, numPages * sizeof(TranslationEntry));
+    machine->FlushBlocks(oldTable);
+    if (machine->pageTable == oldTable) {
+	machine->pageTable = pageTable;
+	machine->pageTableSize = size;
+    }
+    delete [] oldTable;
+    numPages = size;
 }
 
+//----------------------------------------------------------------------
+// AddrSpace::ReleasePage
+// 	Give back the frame, or the swap page, holding virtual page "vpn",
+//	and leave the page empty.  No TLB may go on translating it.
+//	Called for every page when the program exits.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::ReleasePage(int vpn)
+{
+    TranslationEntry *entry = &pageTable[vpn];
+    int frame = entry->physicalPage;
+
+    if (entry->valid) {
+	ReleaseFrame(this, vpn);	// unless others still share it
+	if (machine->tlb != NULL)
+	    for (int i = 0; i < TLBSize; i++)
+		if (machine->tlb[i].physicalPage == frame)
+		    machine->tlb[i].valid = FALSE;
+	scheduler->InvalidateTLBs(frame);
+    } else if (entry->dirty && (entry->swapPage >= 0))
+	ReleaseSwap(entry);
+    entry->valid = FALSE;
+    entry->dirty = FALSE;
+    entry->swapPage = -1;
+    entry->fileAddr = -1;
+    entry->mappedFile = NULL;
+}
@@ -16,10 +16,25 @@
 #include "filesys.h"
 
 #define UserStackSize		1024 	// increase this as necessary!
+#define MaxMappings		4	// files a program may have mapped at once
+
+// A file mapped into an address space by Mmap.  Its pages are loaded
+// from the file, and written back to it, instead of to swap space.
+
+class Mapping {
+  public:
+    int firstPage;			// virtual page it starts at
+    int numPages;
+    OpenFile *file;			// opened for the mapping
+    char *name;				// so a forked child can open it too
+};
 
 class AddrSpace {
   public:
     AddrSpace(AddrSpace* cpy);
+    AddrSpace(unsigned int size);	// Create an address space of "size"
+					// pages, whose page table the caller
+					// fills in (from a checkpoint)
     AddrSpace(OpenFile *executable); // Create an address space,
                                      // initializing it with the program
                                      // stored in the file "executable"
@@ -31,12 +46,33 @@ class AddrSpace {
     void SaveState();			// Save/restore address space-specific
     void RestoreState();		// info on a context switch 
 
+    int Map(char *name);		// Map the file "name" above the rest
+					// of the address space; return its
+					// address, or 0
+    bool Unmap(int addr);		// Write back and unmap the file
+					// mapped at "addr"
+    void UnmapAll();			// Unmap every file, on exit
+    void ReleasePage(int vpn);		// Free its frame or swap page
+
   //private:
     TranslationEntry *pageTable;	// Assume linear page table translation
 					// for now!
 
     unsigned int numPages;		// Number of pages in the virtual 
 					// address space
+    Profile *profile;			// instruction profile of the
+					// program, if we are profiling
+
+    Mapping mappings[MaxMappings];	// files mapped, in no order
+    int numMappings;
+    unsigned int basePages;		// pages below the mapped files
+
+    int nextFault;			// the page after the last ones brought
+    int faultWindow;			// in on a fault, and how many were
+					// brought in after the one faulted on
+
+  private:
+    void Grow(unsigned int size);	// Enlarge the page table
 };
 
 #endif // ADDRSPACE_H
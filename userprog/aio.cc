@@ -0,0 +1,316 @@
+// aio.cc
+//	Routines to carry out user programs' asynchronous file I/O.  See
+//	aio.h.
+//
+//	Requests wait on a single queue for AioWorkers kernel threads,
+//	forked when the first request comes in.  A worker takes a request,
+//	does the transfer -- blocking, with the real file system, on the
+//	disk while user programs run -- and marks it done.  Finished
+//	requests stay on the list of requests until their owner reaps them
+//	(or exits), so the list is short as long as programs reap.
+//
+//	All of the lists are only touched with interrupts off.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "aio.h"
+
+//----------------------------------------------------------------------
+// AioRequest::AioRequest
+// 	Initialize a request, with an empty buffer.
+//
+//	"thread" -- the thread queueing it
+//	"openFile" -- the file to transfer to or from; NULL for the console
+//	"unixFd" -- if so, the UNIX file standing for the console
+//	"isRead" -- TRUE to read from the file, FALSE to write to it
+//	"pos" -- where in the file to start
+//----------------------------------------------------------------------
+
+AioRequest::AioRequest(Thread *thread, OpenFile *openFile, int unixFd,
+		       bool isRead, int pos)
+{
+    owner = thread;
+    file = openFile;
+    fd = unixFd;
+    reading = isRead;
+    position = pos;
+    numPages = numSpans = 0;
+    done = FALSE;
+    result = 0;
+    next = NULL;
+}
+
+//----------------------------------------------------------------------
+// AioWorker
+// 	The body of a worker thread.  "arg" is the queue.
+//----------------------------------------------------------------------
+
+static void
+AioWorker(int arg)
+{
+    ((AsyncIO *) arg)->Work();
+}
+
+//----------------------------------------------------------------------
+// AsyncIO::AsyncIO, AsyncIO::~AsyncIO
+// 	Set up, and tear down, the queue of requests.
+//----------------------------------------------------------------------
+
+AsyncIO::AsyncIO()
+{
+    pending = new List;
+    queued = new Semaphore("aio queued", 0);
+    requests = NULL;
+    sleepers = new List;
+    nextId = 0;
+    pinned = 0;
+    started = FALSE;
+}
+
+AsyncIO::~AsyncIO()
+{
+    delete pending;
+    delete queued;
+    delete sleepers;
+}
+
+//----------------------------------------------------------------------
+// AsyncIO::CanPin
+// 	Return TRUE if a request may pin "numPages" more pages of memory.
+//	Requests together pin at most half of memory, so that the
+//	programs waiting for them can still be paged; the caller must
+//	also reserve the pins against the budget shared with everything
+//	else that pins frames (ReservePins).
+//----------------------------------------------------------------------
+
+bool
+AsyncIO::CanPin(int numPages)
+{
+    return pinned + numPages <= NumPhysPages / 2;
+}
+
+//----------------------------------------------------------------------
+// AsyncIO::Submit
+// 	Queue "request", whose buffer the caller has already pinned, and
+//	return the id Reap will report it by.
+//----------------------------------------------------------------------
+
+int
+AsyncIO::Submit(AioRequest *request)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    if (!started) {
+	for (int i = 0; i < AioWorkers; i++)
+	    (new Thread("aio worker"))->Fork(AioWorker, (void *) this);
+	started = TRUE;
+    }
+    request->id = nextId++;
+    pinned += request->numPages;
+    request->next = requests;
+    requests = request;
+    pending->Append((void *) request);
+    (void) interrupt->SetLevel(oldLevel);
+    queued->V();
+    return request->id;
+}
+
+//----------------------------------------------------------------------
+// AsyncIO::Work
+// 	Carry out queued requests, one at a time, forever.  The buffer
+//	is a list of pieces of main memory, which stay put since they
+//	are pinned; each one is a single transfer.  A short transfer
+//	(the end of the file) ends the request.
+//----------------------------------------------------------------------
+
+void
+AsyncIO::Work()
+{
+    AioRequest *request;
+    IntStatus oldLevel;
+    int i, n, position;
+
+    for (;;) {
+	queued->P();
+	oldLevel = interrupt->SetLevel(IntOff);
+	request = (AioRequest *) pending->Remove();
+	(void) interrupt->SetLevel(oldLevel);
+
+	DEBUG('a', "Async %s of %d pieces at %d for %s\n",
+	      request->reading ? "read" : "write", request->numSpans,
+	      request->position, request->owner->getName());
+	position = request->position;
+	for (i = 0; i < request->numSpans; i++) {
+	    char *span = request->span[i];
+	    int size = request->spanSize[i];
+
+	    if (request->file == NULL) {
+		if (request->reading)
+		    n = traceLog->ReadPartial(request->fd, span, size);
+		else {
+		    WriteFile(request->fd, span, size);
+		    n = size;
+		}
+	    } else if (request->reading)
+		n = request->file->ReadAt(span, size, position);
+	    else
+		n = request->file->WriteAt(span, size, position);
+	    if (n <= 0)
+		break;
+	    request->result += n;
+	    position += n;
+	    if (n < size)
+		break;
+	}
+	Finish(request);
+    }
+}
+
+//----------------------------------------------------------------------
+// AsyncIO::Finish
+// 	Mark "request" done: unpin its buffer, forget whatever was
+//	predecoded from memory a read overwrote, and wake up any thread
+//	waiting for a completion (each checks whether it is its own).
+//----------------------------------------------------------------------
+
+void
+AsyncIO::Finish(AioRequest *request)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    Thread *thread;
+    int i, frame;
+
+    for (i = 0; i < request->numSpans; i++) {
+	char *span = request->span[i];
+
+	for (frame = (span - machine->mainMemory) / PageSize;
+		frame * PageSize < span + request->spanSize[i]
+						- machine->mainMemory;
+		frame++) {
+	    machine->frames[frame].pinCount--;
+	    if (request->reading)
+		machine->InvalidateFrame(frame);
+	}
+    }
+    pinned -= request->numPages;
+    ReleasePins(request->numPages);
+    request->done = TRUE;
+    while ((thread = (Thread *) sleepers->Remove()) != NULL)
+	scheduler->ReadyToRun(thread);
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// AsyncIO::Outstanding
+// 	Return how many of "owner"'s unreaped requests are finished (if
+//	"done"), or not.
+//----------------------------------------------------------------------
+
+int
+AsyncIO::Outstanding(Thread *owner, bool done)
+{
+    int count = 0;
+
+    for (AioRequest *request = requests; request != NULL;
+						request = request->next)
+	if ((request->owner == owner) && (request->done == done))
+	    count++;
+    return count;
+}
+
+//----------------------------------------------------------------------
+// AsyncIO::Reap
+// 	Take up to "max" of the current thread's finished requests off
+//	the list, oldest first, leaving their ids and results in "ids"
+//	and "results".  Return how many were taken.
+//
+//	"wait" -- if none are finished, but some are still outstanding,
+//		wait for one
+//----------------------------------------------------------------------
+
+int
+AsyncIO::Reap(int *ids, int *results, int max, bool wait)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    AioRequest **link, *oldest, **oldestLink;
+    int count;
+
+    while (wait && (Outstanding(currentThread, TRUE) == 0)
+		&& (Outstanding(currentThread, FALSE) > 0)) {
+	sleepers->Append((void *) currentThread);
+	currentThread->Sleep();
+    }
+    for (count = 0; count < max; count++) {
+	oldest = NULL;			// the list is newest first
+	for (link = &requests; *link != NULL; link = &(*link)->next)
+	    if (((*link)->owner == currentThread) && (*link)->done) {
+		oldest = *link;
+		oldestLink = link;
+	    }
+	if (oldest == NULL)
+	    break;
+	*oldestLink = oldest->next;
+	ids[count] = oldest->id;
+	results[count] = oldest->result;
+	delete oldest;
+    }
+    (void) interrupt->SetLevel(oldLevel);
+    return count;
+}
+
+//----------------------------------------------------------------------
+// AsyncIO::Wait
+// 	Wait until all of "owner"'s requests have finished: before its
+//	files are closed, or its memory freed.
+//----------------------------------------------------------------------
+
+void
+AsyncIO::Wait(Thread *owner)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    while (Outstanding(owner, FALSE) > 0) {
+	sleepers->Append((void *) currentThread);
+	currentThread->Sleep();
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// AsyncIO::Forget
+// 	Throw away "owner"'s finished requests, which it will never reap
+//	now.  Call Wait first.
+//----------------------------------------------------------------------
+
+void
+AsyncIO::Forget(Thread *owner)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    AioRequest **link = &requests, *request;
+
+    while ((request = *link) != NULL)
+	if (request->owner == owner) {
+	    ASSERT(request->done);
+	    *link = request->next;
+	    delete request;
+	} else
+	    link = &request->next;
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// AsyncIO::IdleWorkers
+// 	Return how many worker threads are only waiting for work: all of
+//	them, once forked, if no request is queued, in progress or
+//	unreaped.  A checkpoint leaves those out.
+//----------------------------------------------------------------------
+
+int
+AsyncIO::IdleWorkers()
+{
+    return (started && (requests == NULL)) ? AioWorkers : 0;
+}
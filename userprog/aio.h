@@ -0,0 +1,90 @@
+// aio.h
+//	Data structures for asynchronous file I/O by user programs.
+//
+//	ReadAsync and WriteAsync queue a transfer between a user buffer
+//	and a file, and return at once; kernel worker threads carry it
+//	out, while the program goes on computing, and Reap collects the
+//	results.  The user buffer is pinned in memory from the time the
+//	request is queued until it completes, and the transfer goes
+//	straight between the file and the buffer's page frames.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef AIO_H
+#define AIO_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "list.h"
+#include "thread.h"
+#include "synch.h"
+#include "openfile.h"
+
+#define AioWorkers	2	// kernel threads doing the transfers
+#define MaxAioPages	16	// pages one request may cover; a longer
+				// request is cut short, as a Read may be
+
+// The following class defines one queued transfer.  The kernel fills
+// in the user buffer as pieces of main memory, already pinned.
+
+class AioRequest {
+  public:
+    AioRequest(Thread *thread, OpenFile *openFile, int unixFd,
+	       bool isRead, int pos);
+
+    int id;			// how the program knows it, in Reap
+    Thread *owner;		// the thread that queued it
+    OpenFile *file;		// the file, or NULL for the UNIX file fd
+    int fd;			// (the console)
+    bool reading;		// TRUE: from the file into the buffer
+    int position;		// offset in the file
+
+    int numPages;		// pages of the buffer, pinned
+    int numSpans;		// the buffer, as pieces of main memory
+    char *span[MaxAioPages];
+    int spanSize[MaxAioPages];
+
+    bool done;			// transfer finished?
+    int result;			// if so, the # of bytes transferred
+    AioRequest *next;		// on the list of requests not yet reaped
+};
+
+// The following class defines the queue of requests, and the
+// completions not yet reaped, for all user programs.
+
+class AsyncIO {
+  public:
+    AsyncIO();			// Initialize an empty queue
+    ~AsyncIO();
+
+    bool CanPin(int numPages);	// may a request pin this many more?
+    int Submit(AioRequest *request);	// queue a request, return its id
+    int Reap(int *ids, int *results, int max, bool wait);
+				// Take up to "max" completed requests of
+				// the current thread; if "wait", block
+				// until there is one, unless it has none
+				// outstanding.  Return how many.
+    void Wait(Thread *owner);	// Wait until none of "owner"'s requests
+				// are outstanding
+    void Forget(Thread *owner);	// Throw away its unreaped completions
+    int IdleWorkers();		// # workers with nothing to do
+
+    void Work();		// What each worker thread does
+
+  private:
+    int Outstanding(Thread *owner, bool done);
+				// # requests of "owner", finished or not
+    void Finish(AioRequest *request);	// unpin it, wake up the waiters
+
+    List *pending;		// requests queued, not yet started
+    Semaphore *queued;		// counts them, for the workers
+    AioRequest *requests;	// every request not yet reaped
+    List *sleepers;		// threads waiting for a completion
+    int nextId;
+    int pinned;			// pages pinned by queued requests
+    bool started;		// have the workers been forked?
+};
+
+#endif // AIO_H
@@ -23,8 +23,9 @@ BitMap::BitMap(int nitems)
     numBits = nitems;
     numWords = divRoundUp(numBits, BitsInWord);
     map = new unsigned int[numWords];
-    for (int i = 0; i < numBits; i++) 
-        Clear(i);
+    for (int i = 0; i < numWords; i++) 
+        map[i] = 0;
+    hint = 0;
 }
 
 //----------------------------------------------------------------------
@@ -83,23 +84,115 @@ BitMap::Test(int which)
 	return FALSE;
 }
 
+//----------------------------------------------------------------------
+// BitMap::Word
+// 	Return word "w" of the bitmap, with the unused bits at the end of
+//	the last word set, so that they are never found clear.  (They may
+//	hold anything, after FetchFrom.)
+//----------------------------------------------------------------------
+
+unsigned int
+BitMap::Word(int w)
+{
+    int used = numBits - w * BitsInWord;
+
+    if (used >= BitsInWord)
+	return map[w];
+    return map[w] | (~0U << used);
+}
+
+//----------------------------------------------------------------------
+// BitMap::NextClear, BitMap::NextSet
+// 	Return the number of the first bit, from "which" on, that is
+//	clear (or set); numBits if there is none.  Whole words are
+//	skipped at once.
+//----------------------------------------------------------------------
+
+int
+BitMap::NextClear(int which)
+{
+    int w = which / BitsInWord;
+    unsigned int bits;
+
+    if (which >= numBits)
+	return numBits;
+    bits = ~Word(w) & (~0U << (which % BitsInWord));
+    while (bits == 0) {
+	if (++w == numWords)
+	    return numBits;
+	bits = ~Word(w);
+    }
+    return w * BitsInWord + __builtin_ctz(bits);
+}
+
+int
+BitMap::NextSet(int which)
+{
+    int w = which / BitsInWord;
+    unsigned int bits;
+
+    if (which >= numBits)
+	return numBits;
+    bits = Word(w) & (~0U << (which % BitsInWord));
+    while (bits == 0) {
+	if (++w == numWords)
+	    return numBits;
+	bits = Word(w);
+    }
+    return min(w * BitsInWord + __builtin_ctz(bits), numBits);
+}
+
 //----------------------------------------------------------------------
 // BitMap::Find
-// 	Return the number of the first bit which is clear.
+// 	Return the number of a bit which is clear.
 //	As a side effect, set the bit (mark it as in use).
 //	(In other words, find and allocate a bit.)
 //
+//	The search starts where the last one left off, and wraps around,
+//	so that a nearly full bitmap isn't rescanned from the start on
+//	every call.
+//
 //	If no bits are clear, return -1.
 //----------------------------------------------------------------------
 
 int 
 BitMap::Find() 
 {
-    for (int i = 0; i < numBits; i++)
-	if (!Test(i)) {
-	    Mark(i);
-	    return i;
+    int which = NextClear(hint * BitsInWord);
+
+    if (which == numBits)
+	which = NextClear(0);
+    if (which == numBits)
+	return -1;
+    Mark(which);
+    hint = which / BitsInWord;
+    return which;
+}
+
+//----------------------------------------------------------------------
+// BitMap::FindRange
+// 	Return the number of the first of "n" clear bits in a row, and
+//	set them all.  The lowest such run is taken, so that, for
+//	instance, a file's sectors are allocated next to each other.
+//
+//	If there is no such run, return -1.
+//----------------------------------------------------------------------
+
+int
+BitMap::FindRange(int n)
+{
+    int first, end;
+
+    ASSERT(n > 0);
+    for (first = NextClear(0); first + n <= numBits;
+					first = NextClear(end)) {
+	end = NextSet(first);
+	if (end - first >= n) {
+	    for (int i = first; i < first + n; i++)
+		Mark(i);
+	    return first;
 	}
+    }
     return -1;
 }
 
@@ -114,8 +207,8 @@ BitMap::NumClear()
 {
     int count = 0;
 
-    for (int i = 0; i < numBits; i++)
-	if (!Test(i)) count++;
+    for (int w = 0; w < numWords; w++)
+	count += __builtin_popcount(~Word(w));
     return count;
 }
 
@@ -150,6 +243,7 @@ void
 BitMap::FetchFrom(OpenFile *file) 
 {
     file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    hint = 0;
 }
 
 //----------------------------------------------------------------------
@@ -164,3 +258,26 @@ BitMap::WriteBack(OpenFile *file)
 {
    file->WriteAt((char *)map, numWords * sizeof(unsigned), 0);
 }
+
+//----------------------------------------------------------------------
+// BitMap::Checkpoint, BitMap::Restore
+// 	Save the contents of the bitmap, and where Find is to look next,
+//	to a checkpoint of the machine, or restore them from one (see
+//	checkpoint.cc).
+//
+//	"fd" -- the UNIX file holding the checkpoint
+//----------------------------------------------------------------------
+
+void
+BitMap::Checkpoint(int fd)
+{
+    WriteFile(fd, (char *)map, numWords * sizeof(unsigned));
+    WriteFile(fd, (char *)&hint, sizeof(int));
+}
+
+void
+BitMap::Restore(int fd)
+{
+    Read(fd, (char *)map, numWords * sizeof(unsigned));
+    Read(fd, (char *)&hint, sizeof(int));
+}
@@ -8,6 +8,9 @@
 //	The bitmap can be parameterized with with the number of bits being 
 //	managed.
 //
+//	Searches go a word at a time, skipping full words and picking the
+//	clear bit out of a word with the host's count-trailing-zeros.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -43,6 +46,9 @@ class BitMap {
     int Find();            	// Return the # of a clear bit, and as a side
 				// effect, set the bit. 
 				// If no bits are clear, return -1.
+    int FindRange(int n);	// Return the # of the first of "n" clear
+				// bits in a row, and set them all.
+				// If there aren't any, return -1.
     int NumClear();		// Return the number of clear bits
 
     void Print();		// Print contents of bitmap
@@ -52,6 +58,9 @@ class BitMap {
     void FetchFrom(OpenFile *file); 	// fetch contents from disk 
     void WriteBack(OpenFile *file); 	// write contents to disk
 
+    void Checkpoint(int fd);		// save contents to, or restore
+    void Restore(int fd);		// them from, a machine checkpoint
+
   private:
     int numBits;			// number of bits in the bitmap
     int numWords;			// number of words of bitmap storage
@@ -59,6 +68,14 @@ class BitMap {
 					//  multiple of the number of bits in
 					//  a word)
     unsigned int *map;			// bit storage
+    int hint;				// word where Find starts looking: the
+					// one it last found a clear bit in
+
+    unsigned int Word(int w);		// map[w], with the bits past the
+					// end of the bitmap reading as set
+    int NextClear(int which);		// # of the first clear bit, or of
+    int NextSet(int which);		// the first set one, from "which"
+					// on; numBits if there is none
 };
 
 #endif // BITMAP_H
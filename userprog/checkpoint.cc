@@ -0,0 +1,347 @@
+// checkpoint.cc
+//	Routines to save the whole simulated machine to a file, and to
+//	start Nachos again from such a file.
+//
+//	"-cksave <file> <tick>" writes a checkpoint at the first chance
+//	after simulated time reaches <tick>; "-ckload <file>" restores
+//	it, instead of booting and loading programs all over again, and
+//	carries on from there.  A checkpoint holds the hardware -- the
+//	registers, main memory, the TLB, the disk and the pending
+//	interrupts -- the statistics, and the kernel state behind each
+//	user program: its thread, user registers and page table, the
+//	maps of free memory and swap space, and the owner of each frame.
+//
+//	Kernel threads are host code running on host stacks, so they
+//	can't be saved in the middle of what they are doing.  We only
+//	checkpoint between two user instructions, when every thread is
+//	a user program, either running or preempted by the timer, and no
+//	device operation is in progress; at any other time we just try
+//	again on a later tick.  Restored, each thread goes straight back
+//	to its user program.  This also means:
+//
+//	  - only a uniprocessor can be checkpointed
+//	  - files a program opened or mapped itself are not carried over
+//	    (and while it has any, it isn't checkpointed)
+//	  - nor is asynchronous I/O: we wait until every request has been
+//	    reaped.  The idle aio workers are left out; the restored
+//	    kernel forks its own when a program next needs them.
+//	  - the restoring run must be started with the same devices (that
+//	    is, arguments) as the run that was checkpointed, since the
+//	    pending interrupts are matched up with its devices
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "addrspace.h"
+
+#define CheckpointMagic	0x4e434b50	// "NCKP", first word of a checkpoint
+
+// The threads being checkpointed: the current one, then the ready
+// list in order.
+static Thread *threads[MaxThreadNum];
+static int numThreads;
+
+static void
+CollectThread(int arg)
+{
+    threads[numThreads++] = (Thread *) arg;
+}
+
+//----------------------------------------------------------------------
+// Quiescent
+// 	Return TRUE if the machine can be checkpointed now (see above),
+//	and leave the threads to save in "threads".
+//----------------------------------------------------------------------
+
+static bool
+Quiescent()
+{
+    if ((scheduler->numCPUs > 1) || (threadToBeDestroyed != NULL)
+		|| !interrupt->Quiescent())
+	return FALSE;
+    threads[0] = currentThread;
+    numThreads = 1;
+    scheduler->cpus[0].readyList->Mapcar(CollectThread);
+    if (numThreads + asyncIO->IdleWorkers()
+	    != (int) scheduler->AllThreads->NumInList())
+	return FALSE;			// somebody is blocked
+    for (int i = 0; i < numThreads; i++)
+	if ((threads[i]->space == NULL)
+		|| (threads[i]->openFiles->NumInList() > 2)
+		|| (threads[i]->space->numMappings > 0)
+		|| ((i > 0) && !threads[i]->preempted))
+	    return FALSE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// PutString, GetString
+// 	Save a string (or NULL) to a checkpoint, or restore a copy of one.
+//----------------------------------------------------------------------
+
+static void
+PutString(int fd, char *str)
+{
+    int length = (str == NULL) ? 0 : strlen(str) + 1;
+
+    WriteFile(fd, (char *) &length, sizeof(int));
+    WriteFile(fd, str, length);
+}
+
+static char *
+GetString(int fd)
+{
+    int length;
+    char *str;
+
+    Read(fd, (char *) &length, sizeof(int));
+    if (length == 0)
+	return NULL;
+    str = new char[length];
+    Read(fd, str, length);
+    return str;
+}
+
+//----------------------------------------------------------------------
+// SaveThread
+// 	Save a user program's thread to a checkpoint: its name and TID,
+//	what the scheduler knows about it, its user registers and its
+//	address space.
+//----------------------------------------------------------------------
+
+static void
+SaveThread(int fd, Thread *thread)
+{
+    int tid = thread->getTid(), priority = thread->getPriority();
+    AddrSpace *space = thread->space;
+
+    PutString(fd, thread->getName());
+    PutString(fd, thread->executableName);
+    WriteFile(fd, (char *) &tid, sizeof(int));
+    WriteFile(fd, (char *) &priority, sizeof(int));
+    WriteFile(fd, (char *) &thread->time_used, sizeof(int));
+    WriteFile(fd, (char *) &thread->last_tick, sizeof(int));
+    WriteFile(fd, (char *) &thread->syscallRing, sizeof(int));
+    if (thread == currentThread)	// its registers are in the machine
+	WriteFile(fd, (char *) machine->registers, sizeof(machine->registers));
+    else
+	WriteFile(fd, (char *) thread->userRegisters,
+					sizeof(thread->userRegisters));
+    WriteFile(fd, (char *) &space->nextFault, sizeof(int));
+    WriteFile(fd, (char *) &space->faultWindow, sizeof(int));
+    WriteFile(fd, (char *) &space->numPages, sizeof(unsigned int));
+    WriteFile(fd, (char *) space->pageTable,
+			space->numPages * sizeof(TranslationEntry));
+}
+
+//----------------------------------------------------------------------
+// RestoreThread
+// 	Restore a user program's thread from a checkpoint, into "thread",
+//	and return its address space.  The executable is opened again,
+//	for pages not yet loaded from it.
+//----------------------------------------------------------------------
+
+static AddrSpace *
+RestoreThread(int fd, Thread *thread)
+{
+    int tid, priority, nextFault, faultWindow;
+    unsigned int numPages;
+    AddrSpace *space;
+
+    thread->name = GetString(fd);
+    thread->executableName = GetString(fd);
+    Read(fd, (char *) &tid, sizeof(int));
+    Read(fd, (char *) &priority, sizeof(int));
+    thread->SetTid(tid);
+    thread->setPriority(priority);
+    Read(fd, (char *) &thread->time_used, sizeof(int));
+    Read(fd, (char *) &thread->last_tick, sizeof(int));
+    Read(fd, (char *) &thread->syscallRing, sizeof(int));
+    Read(fd, (char *) thread->userRegisters, sizeof(thread->userRegisters));
+    Read(fd, (char *) &nextFault, sizeof(int));
+    Read(fd, (char *) &faultWindow, sizeof(int));
+    Read(fd, (char *) &numPages, sizeof(unsigned int));
+    space = new AddrSpace(numPages);
+    space->nextFault = nextFault;
+    space->faultWindow = faultWindow;
+    Read(fd, (char *) space->pageTable, numPages * sizeof(TranslationEntry));
+
+    if (thread->executableName != NULL) {
+	thread->executable = fileSystem->Open(thread->executableName);
+	ASSERT(thread->executable != NULL);
+	if (profileUser)
+	    space->profile = new Profile(thread->executableName,
+						numPages * PageSize);
+    }
+    return space;
+}
+
+//----------------------------------------------------------------------
+// ResumeProcess
+// 	The first thing a restored thread does: go back to its user
+//	program, as it would on returning from the Yield that preempted
+//	it.  Until now its address space was kept from the scheduler, so
+//	that switching away from it wouldn't save over its registers.
+//
+//	"arg" -- the thread's address space
+//----------------------------------------------------------------------
+
+static void
+ResumeProcess(int arg)
+{
+    currentThread->space = (AddrSpace *) arg;
+    currentThread->RestoreUserState();
+    currentThread->space->RestoreState();
+    machine->Run();
+}
+
+//----------------------------------------------------------------------
+// SaveCheckpoint
+// 	Save the simulated machine to "fileName", if it can be done now.
+//	Called from Interrupt::OneTick, between two user instructions.
+//	Return TRUE if the checkpoint was written.
+//
+//	With the real file system, the disk comes first, right after the
+//	magic number: RestoreCheckpoint reads it twice.
+//----------------------------------------------------------------------
+
+bool
+SaveCheckpoint(char *fileName)
+{
+    int magic = CheckpointMagic;
+    int fd, i, frame, owner, vpn;
+
+    if (!Quiescent())
+	return FALSE;
+
+    fd = OpenForWrite(fileName);
+    WriteFile(fd, (char *) &magic, sizeof(int));
+#ifdef FILESYS
+    synchDisk->Checkpoint(fd);
+#endif
+    WriteFile(fd, (char *) &numThreads, sizeof(int));
+    for (i = 0; i < numThreads; i++)
+	SaveThread(fd, threads[i]);
+    machine->Checkpoint(fd);
+    WriteFile(fd, (char *) &memTime, sizeof(int));
+    WriteFile(fd, (char *) &fifoPtr, sizeof(int));
+    WriteFile(fd, (char *) &scar, sizeof(int));
+
+    // Who owns each frame, as (thread #, virtual page #); -1 if it is
+    // free.  Any other threads sharing it have it at the same page.
+    for (frame = 0; frame < NumPhysPages; frame++) {
+	owner = -1;
+	vpn = machine->frames[frame].vpn;
+	for (i = 0; i < numThreads; i++)
+	    if (machine->frames[frame].owner == threads[i]->space)
+		owner = i;
+	WriteFile(fd, (char *) &owner, sizeof(int));
+	WriteFile(fd, (char *) &vpn, sizeof(int));
+    }
+
+    WriteFile(fd, (char *) stats, sizeof(Statistics));
+    interrupt->Checkpoint(fd);
+    Close(fd);
+
+    printf("Checkpoint of tick %d written to %s\n", stats->totalTicks,
+								fileName);
+    fflush(stdout);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// RestoreCheckpoint
+// 	Replace the freshly booted machine with the one saved in
+//	"fileName", and carry on running it.  Never returns.
+//
+//	The current thread becomes the one that was running; the others
+//	are forked, in the order they were on the ready list.
+//
+//	Restoring runs with interrupts off, so no other thread gets in;
+//	the simulated time spent reopening files is forgotten when the
+//	statistics are restored.  Reopening files also disturbs the disk
+//	cache, so finally the disk and the cache are restored again.
+//----------------------------------------------------------------------
+
+void
+RestoreCheckpoint(char *fileName)
+{
+    int fd = OpenForReadWrite(fileName, TRUE);
+    AddrSpace *spaces[MaxThreadNum];
+    int magic, i, frame, owner, vpn;
+
+    ASSERT(scheduler->numCPUs == 1);
+    ASSERT(scheduler->AllThreads->NumInList() == 1);
+    Read(fd, (char *) &magic, sizeof(int));
+    if (magic != CheckpointMagic) {
+	printf("%s is not a checkpoint\n", fileName);
+	fflush(stdout);
+	ASSERT(FALSE);
+    }
+    (void) interrupt->SetLevel(IntOff);
+
+#ifdef FILESYS
+    synchDisk->Restore(fd);
+    delete fileSystem;				// reread from the restored disk
+    fileSystem = new FileSystem(FALSE);
+    delete machine->swapSpace;
+    machine->swapSpace = fileSystem->Open("SwapSpace");
+    ASSERT(machine->swapSpace != NULL);
+#endif
+    Read(fd, (char *) &numThreads, sizeof(int));
+    ASSERT(numThreads <= MaxThreadNum);
+    for (i = 0; i < numThreads; i++) {
+	threads[i] = (i == 0) ? currentThread : new Thread("restored");
+	spaces[i] = RestoreThread(fd, threads[i]);
+    }
+    machine->Restore(fd);
+    Read(fd, (char *) &memTime, sizeof(int));
+    Read(fd, (char *) &fifoPtr, sizeof(int));
+    Read(fd, (char *) &scar, sizeof(int));
+    for (frame = 0; frame < NumPhysPages; frame++) {
+	Frame *f = &machine->frames[frame];
+
+	Read(fd, (char *) &owner, sizeof(int));
+	Read(fd, (char *) &vpn, sizeof(int));
+	f->owner = (owner < 0) ? NULL : spaces[owner];
+	f->vpn = vpn;
+	for (i = 0; (owner >= 0) && (i < numThreads); i++)
+	    if ((i != owner) && (vpn < (int) spaces[i]->numPages)
+		    && spaces[i]->pageTable[vpn].valid
+		    && (spaces[i]->pageTable[vpn].physicalPage == frame)) {
+		if (f->sharers == NULL)
+		    f->sharers = new List;
+		f->sharers->Append((void *) spaces[i]);
+	    }
+	ASSERT(f->refCount == ((f->sharers == NULL) ? ((owner >= 0) ? 1 : 0)
+					: (int) f->sharers->NumInList() + 1));
+    }
+
+    currentThread->space = spaces[0];
+    for (i = 1; i < numThreads; i++) {
+	int timeUsed = threads[i]->time_used;
+
+	threads[i]->Fork(ResumeProcess, (void *) spaces[i]);
+	threads[i]->time_used = timeUsed;	// ReadyToRun cleared it
+    }
+
+    char *replacePolicy = stats->replacePolicy;	// a pointer into this run
+    Read(fd, (char *) stats, sizeof(Statistics));
+    stats->replacePolicy = replacePolicy;
+    interrupt->Restore(fd);		// interrupts are back on
+#ifdef FILESYS
+    Lseek(fd, sizeof(int), 0);
+    synchDisk->Restore(fd);
+#endif
+    Close(fd);
+
+    printf("Restored checkpoint %s, at tick %d\n", fileName,
+							stats->totalTicks);
+    fflush(stdout);
+    spaces[0]->RestoreState();		// registers are in the machine
+    machine->Run();
+    ASSERT(FALSE);
+}
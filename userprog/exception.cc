@@ -94,8 +94,38 @@ ExceptionHandler(ExceptionType which)
             DEBUG('a', "Yield called by user program.\n");
             Yield1();
         }
+        if(type == SC_ReadAsync) {
+            DEBUG('a', "ReadAsync called by user program.\n");
+            ReadAsync1();
+        }
+        if(type == SC_WriteAsync) {
+            DEBUG('a', "WriteAsync called by user program.\n");
+            WriteAsync1();
+        }
+        if(type == SC_Reap) {
+            DEBUG('a', "Reap called by user program.\n");
+            Reap1();
+        }
+        if(type == SC_RingSetup) {
+            DEBUG('a', "RingSetup called by user program.\n");
+            RingSetup1();
+        }
+        if(type == SC_RingEnter) {
+            DEBUG('a', "RingEnter called by user program.\n");
+            RingEnter1();
+        }
+        if(type == SC_Mmap) {
+            DEBUG('a', "Mmap called by user program.\n");
+            Mmap1();
+        }
+        if(type == SC_Munmap) {
+            DEBUG('a', "Munmap called by user program.\n");
+            Munmap1();
+        }
         if(type == SC_Halt) {
             DEBUG('a', "Shutdown, initiated by user program.\n");
+            if (currentThread->space->profile != NULL)
+                currentThread->space->profile->Dump(currentThread->getTid());
             interrupt->Halt();
         }
         machine->PCAdvance();
@@ -103,6 +133,9 @@ ExceptionHandler(ExceptionType which)
     else if (which == PageFaultException){
             PagefaultHandler();
     }
+    else if (which == ReadOnlyException && CopyOnWriteHandler()){
+            // 复制完毕 重新执行那条写指令
+    }
     else {
         printf("Unexpected user mode exception %d %d\n", which, type);
         //stats->Print();
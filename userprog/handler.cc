@@ -5,10 +5,12 @@
 extern void StartProcess(char* filename);
 
 
-int LRU(){
+// 在vpn所属的TLB组内选择替换项
+int LRU(int vpn){
+    int first = machine->TLBSet(vpn);
     int cur_min = 0x7ffffff;
-    int replace = 0;
-    for (int i = 0; i < TLBSize; i++)
+    int replace = first;
+    for (int i = first; i < first + TLBWays; i++)
         if(machine->tlb[i].last_used < cur_min){
             cur_min = machine->tlb[i].last_used;
             replace = i;
@@ -16,14 +18,45 @@ int LRU(){
     return replace;
 }
 
-int FIFO(){
-    return (fifoPtr++)%TLBSize;
+int FIFO(int vpn){
+    return machine->TLBSet(vpn) + (fifoPtr++)%TLBWays;
 }
 
 //----------------------------------------------------------------------
 // PageFault Handler
+// 缺页时顺带把后面的页面也读进来(fault-around)
+// 只读和缺页的页面来自同一文件 并且在文件里紧挨着的页面 一次ReadAt读完
+// 只用空闲页框 不为了预读换出别人的页面 钉住的名额不够也不预读
 //----------------------------------------------------------------------
 
+// 页面的内容在哪个文件的哪里 交换空间/映射文件/可执行文件
+// 返回NULL表示是全零的新页面
+OpenFile *pageSource(TranslationEntry *entry, int *offset){
+    if(entry->dirty){
+        ASSERT(entry->swapPage >= 0);
+        *offset = entry->swapPage * PageSize;
+        return machine->swapSpace;
+    }
+    *offset = entry->fileAddr;
+    if(entry->mappedFile != NULL)
+        return entry->mappedFile;
+    if(entry->fileAddr >= 0){
+        ASSERT(currentThread->executable != NULL);  // 不能当成全零页
+        return currentThread->executable;
+    }
+    return NULL;
+}
+
+// 这次缺页顺带读几页: 紧接着上次读进来的页面缺页 说明在顺序访问 窗口翻倍
+// 否则从一页重新开始
+int faultAroundWindow(AddrSpace *space, int vpn){
+    if(vpn == space->nextFault)
+        space->faultWindow = min(max(2 * space->faultWindow, 1), machine->faultAround);
+    else
+        space->faultWindow = min(1, machine->faultAround);
+    return space->faultWindow;
+}
+
 void PagefaultHandler(){
     int vaddr = machine->ReadRegister(BadVAddrReg);
     int vpn = (unsigned)vaddr / PageSize;
@@ -34,37 +67,69 @@ void PagefaultHandler(){
         // 如果已经失效 那必定不再TLB中
         DEBUG('a', "F*** Pagefault! Bad vpn %d\n", vpn);
         stats->numPageFaults++;
-        int swapPhysPage = GetPage(machine->pageTable + vpn);
-        // DEBUG('a', "Chose sacrifice page %d\n", swapPhysPage);
-        // 首先看看是否在交换空间中
-        if(machine->pageTable[vpn].dirty){
-            // DEBUG('a', "*** Page needed in swap space\n", vpn);
-            int swapSpacePage = machine->pageTable[vpn].swapPage;
-            ASSERT(swapSpacePage >= 0);
-            machine->pageTable[vpn].swapPage = -1;
-            machine->swapSpace->ReadAt(machine->mainMemory + swapPhysPage * PageSize, PageSize, swapSpacePage * PageSize);
-            DEBUG('a', "Roll in page #%d from swap space...\n", vpn);
-            // 既然已经换回内存了 就完成交换空间的清理
-            machine->swapMap->Clear(swapSpacePage);
+        WaitForPins(1);                 // 读入时要钉住页框 先占名额
+        AddrSpace *space = currentThread->space;
+        int frames[MaxFaultAround + 1];
+        int offset, n = 1;
+        OpenFile *file = pageSource(&machine->pageTable[vpn], &offset);
+        frames[0] = GetPage(space, vpn);
+        // DEBUG('a', "Chose sacrifice page %d\n", frames[0]);
+        if(file != NULL){
+            // 后面的页面 只要还没读进来 又紧接在文件里 并且有空闲页框
+            int window = faultAroundWindow(space, vpn);
+            for (; n <= window && vpn + n < (int)machine->pageTableSize; n++){
+                TranslationEntry *entry = &machine->pageTable[vpn + n];
+                int next;
+                if(entry->valid || pageSource(entry, &next) != file
+                        || next != offset + n * PageSize)
+                    break;
+                if(!ReservePins(1))
+                    break;
+                if((frames[n] = GetPage(space, vpn + n, true)) < 0){
+                    ReleasePins(1);
+                    break;
+                }
+                entry->use = FALSE;             // 还没有真正用到
+            }
+            space->nextFault = vpn + n;
+        }
+        // 读的时候可能让出CPU 钉住页框 免得被别人换走
+        for (int i = 0; i < n; i++)
+            machine->frames[frames[i]].pinCount++;
+        if(file == NULL)
+            bzero(machine->mainMemory + frames[0] * PageSize, PageSize);
+        else if(n == 1){
+            if(file != machine->swapSpace)
+                bzero(machine->mainMemory + frames[0] * PageSize, PageSize);  // 映射文件末尾之后为零
+            file->ReadAt(machine->mainMemory + frames[0] * PageSize, PageSize, offset);
+        }else{
+            // 页框不连续 先读到缓冲区再分给各个页框
+            char *buffer = new char[n * PageSize];
+            bzero(buffer, n * PageSize);
+            file->ReadAt(buffer, n * PageSize, offset);
+            for (int i = 0; i < n; i++)
+                memcpy(machine->mainMemory + frames[i] * PageSize, buffer + i * PageSize, PageSize);
+            delete [] buffer;
         }
-        else if(machine->pageTable[vpn].fileAddr>=0){
-            // 应该在磁盘可执行文件里...
-            //DEBUG('a', "*** Page needed in executable file\n");
-            //OpenFile *execFile = fileSystem->Open(currentThread->execFile);
-            OpenFile *execFile = currentThread->executable;
-            int execFileAddr = machine->pageTable[vpn].fileAddr;
-            DEBUG('a', "Roll in page #%d from executable file...\n", vpn);
-            execFile->ReadAt(machine->mainMemory + swapPhysPage * PageSize, PageSize, execFileAddr);
-        }else
-            bzero(machine->mainMemory + swapPhysPage * PageSize, PageSize);
-        
-        machine->pageTable[vpn].valid = true;
-        machine->pageTable[vpn].physicalPage = swapPhysPage;
+        DEBUG('a', "Roll in pages #%d-%d from %s...\n", vpn, vpn + n - 1,
+              (file == NULL) ? "nowhere" : (file == machine->swapSpace) ? "swap space" : "file");
+        for (int i = 0; i < n; i++){
+            TranslationEntry *entry = &machine->pageTable[vpn + i];
+            machine->frames[frames[i]].pinCount--;
+            if(file == machine->swapSpace){
+                // 既然已经换回内存了 就完成交换空间的清理 (共享的交换页留给别人)
+                ReleaseSwap(entry);
+            }
+            entry->valid = true;
+            entry->physicalPage = frames[i];
+        }
+        ReleasePins(n);
+        stats->numPagesFaultedAround += n - 1;
     }
     if(machine->tlb != NULL){
         //DEBUG('a', "Updating TLB entry...\n");
 
-        int replace = LRU();          // 优先找到失效的TLB项进行替换 默认替换0
+        int replace = LRU(vpn);          // 优先找到失效的TLB项进行替换 默认替换0
         ASSERT(0 <= vpn < machine->pageTableSize);
         // printf("替换TLB第%d项\n", replace);
         machine->tlb[replace] = machine->pageTable[vpn];
@@ -77,14 +142,64 @@ void PagefaultHandler(){
 
 }
 
+//----------------------------------------------------------------------
+// Copy-on-write Handler
+// 写只读页引起的异常 如果是fork后共享的页 就给自己复制一份
+// 别人都已经复制走了的话 直接改回可写
+// 返回FALSE表示这是真正的只读页
+//----------------------------------------------------------------------
+
+bool CopyOnWriteHandler(){
+    int vaddr = machine->ReadRegister(BadVAddrReg);
+    int vpn = (unsigned)vaddr / PageSize;
+    TranslationEntry *entry = machine->pageTable + vpn;
+
+    if((unsigned)vpn >= machine->pageTableSize || !entry->valid || !entry->copyOnWrite)
+        return FALSE;
+    if(machine->frames[entry->physicalPage].refCount > 1){
+        // 先拿到新页框再放手 复制期间钉住原页框 免得它被选为牺牲页
+        // 等名额时页面可能被换出了 那就重新翻译 缺页后再来
+        WaitForPins(1);
+        if(!entry->valid){
+            ReleasePins(1);
+            return TRUE;
+        }
+        int frame = entry->physicalPage;
+        if(machine->frames[frame].refCount > 1){
+            machine->frames[frame].pinCount++;
+            int copy = GetPage(currentThread->space, vpn);
+            machine->frames[frame].pinCount--;
+            DEBUG('a', "Copy on write: page #%d from frame %d to %d\n", vpn, frame, copy);
+            memcpy(machine->mainMemory + copy * PageSize, machine->mainMemory + frame * PageSize, PageSize);
+            ReleaseFrame(currentThread->space, vpn);
+            entry->physicalPage = copy;
+            stats->numPageCopies++;
+        }
+        ReleasePins(1);
+    }
+    entry->readOnly = FALSE;
+    entry->copyOnWrite = FALSE;
+    // TLB里的旧翻译(只读 或旧页框)作废
+    if(machine->tlb != NULL)
+        for (int i = 0; i < TLBSize; i++)
+            if(machine->tlb[i].virtualPage == vpn)
+                machine->tlb[i].valid = false;
+    machine->FlushSoftTLB();
+    return TRUE;
+}
+
 void Exit1(){
     printf("Thread %s exit without error.\n", currentThread->getName());
     int exitId = machine->ReadRegister(2);
+    if (currentThread->space->profile != NULL)
+        currentThread->space->profile->Dump(currentThread->getTid());
     /* 一个程序退出 执行清理工作... */
-    for (int i = 0; i < machine->pageTableSize;i++){
-        if(machine->pageTable[i].valid)
-            machine->memoryMap->Clear(machine->pageTable[i].physicalPage);
-    }
+    asyncIO->Wait(currentThread);       // 异步I/O还钉着它的页框
+    asyncIO->Forget(currentThread);
+    currentThread->space->UnmapAll();   // 映射文件的修改写回文件
+    for (unsigned int i = 0; i < machine->pageTableSize;i++)
+        currentThread->space->ReleasePage(i);   // 共享的页框留给别人
+    machine->FlushBlocks(machine->pageTable);
     currentThread->Finish();
 }
 
@@ -92,84 +207,396 @@ void Exit1(){
 // System calls
 //----------------------------------------------------------------------
 
-void readString(int addr, char *data){
-    int byte;
-    for (int i = 0;; i++){
-        machine->ReadMem(addr + i, 1, &byte);
-        if((data[i] = (char)byte) == 0)
+//----------------------------------------------------------------------
+// 系统调用参数的拷入拷出 (copyin/copyout)
+// 每页只翻译一次 整段memcpy 缺页只在页边界处理
+// 不再逐字节ReadMem/WriteMem
+//----------------------------------------------------------------------
+
+// 返回用户地址addr在主存中的位置 必要时先处理缺页
+// 地址非法(越界或写只读页)返回NULL
+char *userAddress(int addr, bool writing){
+    int physAddr;
+    ExceptionType exception;
+
+    if((unsigned)addr / PageSize >= machine->pageTableSize)
+        return NULL;
+    for(;;){
+        exception = machine->Translate(addr, &physAddr, 1, writing);
+        if(exception == NoException)
+            return machine->mainMemory + physAddr;
+        machine->WriteRegister(BadVAddrReg, addr);
+        if(exception == ReadOnlyException){
+            if(!CopyOnWriteHandler())   // 写时复制 然后重新翻译
+                return NULL;
+            continue;
+        }
+        if(exception != PageFaultException)
+            return NULL;
+        PagefaultHandler();             // 换入页面/填充TLB 然后重新翻译
+        machine->FlushSoftTLB();
+    }
+}
+
+// 同userAddress 但页面不在内存 或要写时复制 就返回NULL
+// 不会缺页或写时复制 也就不会等待 已经钉着页框时用它 (见WaitForPins)
+char *residentAddress(int addr, bool writing){
+    unsigned vpn = (unsigned)addr / PageSize;
+    if(vpn >= machine->pageTableSize || !machine->pageTable[vpn].valid
+            || (writing && machine->pageTable[vpn].readOnly))
+        return NULL;
+    return userAddress(addr, writing);
+}
+
+// 从用户空间拷入size字节 返回实际拷贝的字节数
+int readMemory(int addr, int size, char* data){
+    int done = 0;
+    while(done < size){
+        char *host = userAddress(addr + done, FALSE);
+        if(host == NULL)
             break;
+        int span = PageSize - (unsigned)(addr + done) % PageSize;
+        if(span > size - done)
+            span = size - done;
+        memcpy(data + done, host, span);
+        done += span;
     }
+    return done;
+}
+
+// 主存host处的span字节被内核改写 作废其中预译码过的指令 同WriteMem
+void wroteMemory(char *host, int span){
+    int physAddr = host - machine->mainMemory;
+    for(int i = physAddr / 4; i <= (physAddr + span - 1) / 4; i++)
+        if(machine->decoded[i]){
+            machine->decoded[i] = FALSE;
+            machine->frameGeneration[i * 4 / PageSize]++;
+        }
 }
 
-void readMemory(int addr, int size, char* data){
-    int byte;
-    for (int i = 0; i < size;i++){
-        machine->ReadMem(addr + i, 1, &byte);
-        data[i] = (char)byte;
+// 拷出size字节到用户空间 返回实际拷贝的字节数
+int writeMemory(int addr, int size, char* data){
+    int done = 0;
+    while(done < size){
+        char *host = userAddress(addr + done, TRUE);
+        if(host == NULL)
+            break;
+        int span = PageSize - (unsigned)(addr + done) % PageSize;
+        if(span > size - done)
+            span = size - done;
+        memcpy(host, data + done, span);
+        wroteMemory(host, span);
+        done += span;
+    }
+    return done;
+}
+
+// 拷入以'\0'结尾的字符串 最多size字节(含'\0') 过长则截断
+// 返回字符串长度 地址非法返回-1
+int readString(int addr, char *data, int size){
+    int done = 0;
+    while(done < size){
+        char *host = userAddress(addr + done, FALSE);
+        if(host == NULL)
+            break;
+        int span = PageSize - (unsigned)(addr + done) % PageSize;
+        if(span > size - done)
+            span = size - done;
+        char *end = (char *)memchr(host, '\0', span);
+        if(end != NULL){
+            memcpy(data + done, host, end - host + 1);
+            return done + (end - host);
+        }
+        memcpy(data + done, host, span);
+        done += span;
     }
+    if(done < size){
+        data[done] = '\0';
+        return -1;
+    }
+    data[size - 1] = '\0';
+    return size - 1;
 }
 
-void writeMemory(int addr, int size, char* data){
-    for (int i = 0; i < size;i++)
-        machine->WriteMem(addr + i, 1, (int)data[i]);
+// 文件读写直接在用户缓冲区所在的页框上进行 不经内核缓冲区 (零拷贝)
+// 物理上连续的几页合并成一次I/O 期间钉住这些页框
+// 免得I/O阻塞时被别的线程缺页换出
+// file为NULL时直接读写UNIX文件fd (只用于控制台 见findFile)
+// reading: 从文件读入用户内存; 否则把用户内存写入文件
+// 返回实际传输的字节数
+// 第一页翻译好(可能缺页)再占名额 没有名额就等 等完重新翻译
+// 后面的页面不在内存或没有名额 就留给下一轮: 钉着页框时不缺页 不等待
+#define MAX_PIN_PAGES 16
+int transferMemory(OpenFile *file, int fd, int addr, int size, bool reading){
+    int done = 0, n;
+    while(done < size){
+        char *host = userAddress(addr + done, reading);
+        if(host == NULL)
+            break;
+        if(!ReservePins(1)){
+            WaitForPins(1);
+            ReleasePins(1);
+            continue;
+        }
+        int first = (host - machine->mainMemory) / PageSize, last = first;
+        int span = PageSize - (unsigned)(addr + done) % PageSize;
+        if(span > size - done)
+            span = size - done;
+        machine->frames[first].pinCount++;
+        while((done + span < size) && (last - first + 1 < MAX_PIN_PAGES)
+                && (last - first + 1 < NumPhysPages / 2)){
+            if(residentAddress(addr + done + span, reading) != host + span)
+                break;                  // 不连续(或不在内存/非法) 留给下一轮
+            if(!ReservePins(1))
+                break;
+            machine->frames[++last].pinCount++;
+            span += (size - done - span < PageSize) ? size - done - span : PageSize;
+        }
+        if(file != NULL)
+            n = reading ? file->Read(host, span) : file->Write(host, span);
+        else if(reading)
+            n = traceLog->ReadPartial(fd, host, span);   // 录制/重放控制台输入
+        else{
+            WriteFile(fd, host, span);
+            n = span;
+        }
+        if(reading && (n > 0))
+            wroteMemory(host, n);
+        for(int i = first; i <= last; i++)
+            machine->frames[i].pinCount--;
+        ReleasePins(last - first + 1);
+        if(n <= 0)
+            break;
+        done += n;
+        if(n < span)
+            break;
+    }
+    return done;
+}
+
+// 异步读写: 把用户缓冲区(至多MaxAioPages页)逐页调入并钉住 交给asyncIO
+// 完成前页框不会被换出 由worker线程直接在页框上读写
+// 钉住的名额不够就少读写一些 一页都钉不住就不提交 不等
+// 返回请求号 无法提交返回-1
+int submitAsync(OpenFile *file, int fd, int addr, int size, int position, bool reading){
+    if(size <= 0)
+        return -1;
+    int pages = ((unsigned)(addr + size - 1) / PageSize) - ((unsigned)addr / PageSize) + 1;
+    if(pages > MaxAioPages){
+        pages = MaxAioPages;
+        size = MaxAioPages * PageSize - (unsigned)addr % PageSize;
+    }
+    if(!asyncIO->CanPin(pages))
+        return -1;
+    // 先把缓冲区逐页调入(可能缺页/写时复制) 钉住页框时就不会再缺页了
+    for(int off = 0; off < size; off += PageSize - (unsigned)(addr + off) % PageSize)
+        if(userAddress(addr + off, reading) == NULL)
+            break;
+    AioRequest *request = new AioRequest(currentThread, file, fd, reading, position);
+    int done = 0;
+    while(done < size){
+        // 第一页之外 不在内存了(被后面的页面挤出去) 就到此为止
+        char *host = (done == 0) ? userAddress(addr, reading)
+                                 : residentAddress(addr + done, reading);
+        if(host == NULL || !ReservePins(1))
+            break;
+        int span = PageSize - (unsigned)(addr + done) % PageSize;
+        if(span > size - done)
+            span = size - done;
+        machine->frames[(host - machine->mainMemory) / PageSize].pinCount++;
+        request->numPages++;
+        int last = request->numSpans - 1;
+        if((last >= 0) && (request->span[last] + request->spanSize[last] == host))
+            request->spanSize[last] += span;        // 物理上连续 合并
+        else{
+            request->span[last + 1] = host;
+            request->spanSize[last + 1] = span;
+            request->numSpans++;
+        }
+        done += span;
+    }
+    if(done == 0){
+        delete request;
+        return -1;
+    }
+    return asyncIO->Submit(request);
 }
 
 #define MAX_NAME_LEN 100
-void Open1(){
-    int nameAddr = machine->ReadRegister(4);
+// 以下几个系统调用 既可以直接陷入 也可以经由请求环批量提交
+int sysOpen(int nameAddr){
     char name[MAX_NAME_LEN];
-    readString(nameAddr, name);
+    readString(nameAddr, name, MAX_NAME_LEN);
     OpenFileId fd = OpenForReadWrite(name, TRUE);
     //printf("file %s opened as fd %d\n", name, fd);
     OpenFile *file = new OpenFile(fd);
     currentThread->openFiles->SortedInsert((void *)file, fd);
-    machine->WriteRegister(2, fd);
+    return fd;
 }
 
-void Create1(){
-    int nameAddr = machine->ReadRegister(4);
+int sysCreate(int nameAddr){
     char name[MAX_NAME_LEN];
-    readString(nameAddr, name);
+    readString(nameAddr, name, MAX_NAME_LEN);
     OpenFileId fd = OpenForWrite(name);
     Close(fd);
+    return 0;
+}
+
+// 读写fd对应的文件 从控制台读/往控制台写时为NULL 直接读写UNIX文件
+// 返回FALSE表示本线程没有打开这个fd 不能让它碰模拟器自己的UNIX文件
+bool findFile(OpenFileId fd, bool reading, OpenFile **file){
+    *file = NULL;
+    if(fd == (reading ? ConsoleInput : ConsoleOutput))
+        return TRUE;
+    *file = (OpenFile*)currentThread->openFiles->Find(fd);
+    return *file != NULL;
+}
+
+int sysWrite(int bufferAddr, int size, OpenFileId fd){
+    OpenFile *file;
+    if(!findFile(fd, FALSE, &file))
+        return -1;
+    return transferMemory(file, fd, bufferAddr, size, FALSE);
+}
+
+int sysRead(int bufferAddr, int size, OpenFileId fd){
+    OpenFile *file;
+    if(!findFile(fd, TRUE, &file))
+        return -1;
+    return transferMemory(file, fd, bufferAddr, size, TRUE);
+}
+
+int sysClose(OpenFileId fd){
+    //printf("Closing fd %d\n", fd);
+    OpenFile *file = (OpenFile *)currentThread->openFiles->Find(fd);
+    asyncIO->Wait(currentThread);       // 可能还有对它的异步I/O
+    delete file;
+    currentThread->openFiles->Remove(file);
+    return 0;
+}
+
+void Open1(){
+    machine->WriteRegister(2, sysOpen(machine->ReadRegister(4)));
+}
+
+void Create1(){
+    sysCreate(machine->ReadRegister(4));
 }
 
 void Write1(){
+    sysWrite(machine->ReadRegister(4), machine->ReadRegister(5),
+             machine->ReadRegister(6));
+}
+
+void Read1(){
+    machine->WriteRegister(2, sysRead(machine->ReadRegister(4),
+                                      machine->ReadRegister(5),
+                                      machine->ReadRegister(6)));
+}
+
+void ReadAsync1(){
     int bufferAddr = machine->ReadRegister(4);
     int size = machine->ReadRegister(5);
-    char* buffer = new char[size];
-    readMemory(bufferAddr, size, buffer);
     OpenFileId fd = machine->ReadRegister(6);
-    if(fd>1){
-        OpenFile *file = (OpenFile*)currentThread->openFiles->Find(fd);
-        //printf("Writing %s to fd %d\n", buffer, fd);
-        file->Write(buffer, size);
-    }
-    else WriteFile(fd, buffer, size);
+    int position = machine->ReadRegister(7);
+    OpenFile *file;
+    if(!findFile(fd, TRUE, &file))
+        machine->WriteRegister(2, -1);
+    else
+        machine->WriteRegister(2, submitAsync(file, fd, bufferAddr, size, position, TRUE));
 }
 
-void Read1(){
+void WriteAsync1(){
     int bufferAddr = machine->ReadRegister(4);
     int size = machine->ReadRegister(5);
-    char* buffer = new char[size];
     OpenFileId fd = machine->ReadRegister(6);
-    OpenFile *file = (OpenFile*)currentThread->openFiles->Find(fd);
-    file->Read(buffer, size);
-    writeMemory(bufferAddr, size, buffer);
+    int position = machine->ReadRegister(7);
+    OpenFile *file;
+    if(!findFile(fd, FALSE, &file))
+        machine->WriteRegister(2, -1);
+    else
+        machine->WriteRegister(2, submitAsync(file, fd, bufferAddr, size, position, FALSE));
+}
+
+// 取回已完成的异步请求 以AioResult {id, result} 数组写回用户空间
+#define MAX_REAP 16
+void Reap1(){
+    int resultsAddr = machine->ReadRegister(4);
+    int max = machine->ReadRegister(5);
+    bool wait = machine->ReadRegister(6) != 0;
+    int ids[MAX_REAP], results[MAX_REAP], pair[2];
+    if(max > MAX_REAP)
+        max = MAX_REAP;
+    int count = asyncIO->Reap(ids, results, max, wait);
+    for(int i = 0; i < count; i++){
+        pair[0] = WordToMachine(ids[i]);
+        pair[1] = WordToMachine(results[i]);
+        writeMemory(resultsAddr + i * sizeof(pair), sizeof(pair), (char *)pair);
+    }
+    machine->WriteRegister(2, count);
 }
 
 void Close1(){
-    OpenFileId fd = machine->ReadRegister(4);
-    //printf("Closing fd %d\n", fd);
-    OpenFile *file = (OpenFile *)currentThread->openFiles->Find(fd);
-    delete file;
-    currentThread->openFiles->Remove(file);
+    sysClose(machine->ReadRegister(4));
+}
+
+// 把文件映射到地址空间顶端 返回映射的地址 失败返回0
+void Mmap1(){
+    char name[MAX_NAME_LEN];
+    readString(machine->ReadRegister(4), name, MAX_NAME_LEN);
+    machine->WriteRegister(2, currentThread->space->Map(name));
+}
+
+void Munmap1(){
+    int addr = machine->ReadRegister(4);
+    asyncIO->Wait(currentThread);       // 异步I/O可能还钉着映射的页框
+    machine->WriteRegister(2, currentThread->space->Unmap(addr) ? 0 : -1);
+}
+
+// 请求环 整个环一次拷入 逐项执行 再一次拷回
+void RingSetup1(){
+    currentThread->syscallRing = machine->ReadRegister(4);
+}
+
+void RingEnter1(){
+    SyscallRing ring;
+    int ringAddr = currentThread->syscallRing;
+    int head, tail, count;
+    if(ringAddr == 0
+       || readMemory(ringAddr, sizeof(ring), (char *)&ring) != sizeof(ring)){
+        machine->WriteRegister(2, -1);
+        return;
+    }
+    head = WordToHost(ring.head);
+    tail = WordToHost(ring.tail);
+    count = tail - head;
+    if(count < 0 || count > RingSize)    // 环被用户写乱了
+        count = 0;
+    for(int i = 0; i < count; i++){
+        RingEntry *entry = &ring.entries[(unsigned)(head + i) % RingSize];
+        int arg1 = WordToHost(entry->arg1);
+        int arg2 = WordToHost(entry->arg2);
+        int arg3 = WordToHost(entry->arg3);
+        int result;
+        switch(WordToHost(entry->op)){
+          case SC_Create: result = sysCreate(arg1); break;
+          case SC_Open:   result = sysOpen(arg1); break;
+          case SC_Read:   result = sysRead(arg1, arg2, arg3); break;
+          case SC_Write:  result = sysWrite(arg1, arg2, arg3); break;
+          case SC_Close:  result = sysClose(arg1); break;
+          default:        result = -1; break;
+        }
+        entry->result = WordToMachine(result);
+    }
+    ring.head = WordToMachine(head + count);
+    writeMemory(ringAddr, sizeof(ring), (char *)&ring);
+    machine->WriteRegister(2, count);
 }
 
 void Exec1(){
     int nameAddr = machine->ReadRegister(4);
     char* name = new char[MAX_NAME_LEN];
-    readString(nameAddr, name);
+    readString(nameAddr, name, MAX_NAME_LEN);
     Thread *t = new Thread("SYSCALL_EXEC");
     //printf("Exec called: exec %s\n", name);
     t->Fork((VoidFunctionPtr)StartProcess, name);
@@ -186,8 +613,11 @@ void fork_init(int pc){
 
 void Fork1(){
     int funcPeta = machine->ReadRegister(4);
+    asyncIO->Wait(currentThread);       // 异步I/O钉着的页框不能写时复制共享
     Thread *t = new Thread("SYSCALL_FORK");
     t->space = new AddrSpace(currentThread->space);
+    t->executable = currentThread->executable;          // 共享的代码页被换出后
+    t->executableName = currentThread->executableName;  // 要从这里重新读入
     //t->SaveUserState(); // 寄存器状态相同 tricky (*^▽^*)
     t->Fork((VoidFunctionPtr)fork_init, (void *)funcPeta);
 }
@@ -36,6 +36,9 @@ StartProcess(char *filename)
     space = new AddrSpace(executable);    
     currentThread->space = space;   // 已经帮我做了...?
     currentThread->executable = executable;
+    currentThread->executableName = filename;
+    if (profileUser)
+        space->profile = new Profile(filename, space->numPages * PageSize);
 
     //delete executable;			// close file
 
@@ -29,6 +29,13 @@
 #define SC_Close	8
 #define SC_Fork		9
 #define SC_Yield	10
+#define SC_ReadAsync	11
+#define SC_WriteAsync	12
+#define SC_Reap		13
+#define SC_RingSetup	14
+#define SC_RingEnter	15
+#define SC_Mmap		16
+#define SC_Munmap	17
 
 #ifndef IN_ASM
 
@@ -107,6 +114,74 @@ int Read(char *buffer, int size, OpenFileId id);
 /* Close the file, we're done reading and writing to it. */
 void Close(OpenFileId id);
 
+/* Asynchronous I/O: start reading (writing) "size" bytes into (from)
+ * "buffer", at "position" in the open file, and return at once, with an
+ * identifier for the request -- or -1 if it can't be queued, because
+ * too much I/O is in progress.  At most 16 pages of the buffer are
+ * transferred.  The buffer must be left alone until the request has
+ * been reaped.  (Position is ignored for the console.)
+ */
+typedef int AioId;
+
+AioId ReadAsync(char *buffer, int size, OpenFileId id, int position);
+AioId WriteAsync(char *buffer, int size, OpenFileId id, int position);
+
+/* A finished asynchronous request, and the number of bytes it
+ * transferred.
+ */
+typedef struct {
+    AioId id;
+    int result;
+} AioResult;
+
+/* Store up to "max" finished requests in "results", oldest first, and
+ * return how many.  If "wait" is nonzero and none have finished, wait
+ * for one first (unless none are in progress).
+ */
+int Reap(AioResult *results, int max, int wait);
+
+/* Batched system calls.  A program registers a ring of requests in its
+ * own memory with RingSetup, then queues requests by filling in
+ * entries[tail % RingSize] and advancing tail, and has the kernel carry
+ * out everything from head to tail with a single RingEnter.  The kernel
+ * leaves each request's return value in its "result", sets head to
+ * tail, and returns how many requests it carried out (-1 if there is
+ * no ring).  "op" is SC_Create, SC_Open, SC_Read, SC_Write or SC_Close,
+ * with the arguments of that call, in order; the result of any other
+ * op is -1.  Names passed to Create and Open are still read from the
+ * program's memory.  RingSetup(0) forgets the ring.
+ */
+#define RingSize	8
+
+typedef struct {
+    int op;
+    int arg1, arg2, arg3;
+    int result;
+} RingEntry;
+
+typedef struct {
+    int head;
+    int tail;
+    RingEntry entries[RingSize];
+} SyscallRing;
+
+void RingSetup(SyscallRing *ring);
+int RingEnter();
+
+/* Map the Nachos file "name", all of it, into the address space, above
+ * everything else, and return where it starts -- or 0 if it can't be
+ * mapped.  Its pages are read from the file when first touched, and
+ * the ones the program changes are written back to the file when they
+ * are evicted, when it is unmapped, or when the program exits.  The
+ * rest of the last page reads as zeros, and is not written back.
+ */
+char *Mmap(char *name);
+
+/* Unmap the file mapped at "addr", writing back what was changed.
+ * Return 0, or -1 if nothing is mapped there.
+ */
+int Munmap(char *addr);
+
 /* User-level thread operations: Fork and Yield.  To allow multiple
  * threads to run within a user program. 
  */